@@ -0,0 +1,122 @@
+#include "calibr.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "eeprom_driver.h"
+#include "eeprom_record.h"
+
+
+_Static_assert((offsetof(calibr_t, points_qty) + 1) == CALIBR_RECORD_SIZE, "calibr: record payload is not the head of calibr_t");
+
+
+
+
+// Returns false if there is no valid record, points are not precomputed here - call calibr_update()
+bool calibr_load(calibr_t *calibr, eeprom_record_t *rec) {
+    if (!eeprom_record_load(rec, calibr) || (calibr->points_qty < 2) || (calibr->points_qty > CALIBR_MAX_POINTS)) {
+        calibr->points_qty = 0;
+        return false;
+    }
+    return true;
+}
+
+
+void calibr_save(const calibr_t *calibr, eeprom_record_t *rec) {
+    eeprom_record_save(rec, calibr);
+}
+
+
+// Raw block written over the CLI, the caller saves it as a record
+bool calibr_load_raw(calibr_t *calibr, uint16_t ee_addr) {
+    uint8_t i;
+
+
+    calibr->points_qty = 0;
+    eeprom_driver_read_8(ee_addr, &i);
+    if ((i < 2) || (i > CALIBR_MAX_POINTS)) return false;
+    calibr->points_qty = i;
+    ee_addr++;
+
+    for (i = 0; i < calibr->points_qty; i++) {
+        eeprom_driver_read_16(ee_addr, &calibr->x[i]);
+        eeprom_driver_read_16((ee_addr + 2), &calibr->y[i]);
+        ee_addr += 4;
+    }
+
+    return true;
+}
+
+
+// Validate points and precompute segment slopes, must be called after any points change.
+// Common shift is the biggest one (<= 16) where all slopes still fit in 16 bits.
+bool calibr_update(calibr_t *calibr) {
+    uint8_t i;
+    uint16_t dx, dy;
+
+
+    calibr->slope_shift = 16;
+    if ((calibr->points_qty < 2) || (calibr->points_qty > CALIBR_MAX_POINTS)) {
+        calibr->points_qty = 0;
+        return false;
+    }
+
+    for (i = 0; i < (calibr->points_qty - 1); i++) {
+        if (calibr->x[i + 1] <= calibr->x[i]) {
+            calibr->points_qty = 0;
+            return false;
+        }
+        if (calibr->y[i + 1] < calibr->y[i]) {
+            calibr->points_qty = 0;
+            return false;
+        }
+
+        dx = calibr->x[i + 1] - calibr->x[i];
+        dy = calibr->y[i + 1] - calibr->y[i];
+        while ((calibr->slope_shift > 0) && ((((uint32_t)dy << calibr->slope_shift) / dx) > 0xFFFF)) calibr->slope_shift--;
+    }
+
+    for (i = 0; i < (calibr->points_qty - 1); i++) {
+        dx = calibr->x[i + 1] - calibr->x[i];
+        dy = calibr->y[i + 1] - calibr->y[i];
+        calibr->slope[i] = (uint16_t)(((uint32_t)dy << calibr->slope_shift) / dx);
+    }
+
+    return true;
+}
+
+
+// Binary search + one 16x16->32 multiply, outer segments are extrapolated
+// y = y1 + ((y2 - y1) / (x2 - x1)) * (x - x1)
+uint16_t calibr_calc(const calibr_t *calibr, uint16_t x) {
+    uint8_t low, high, mid;
+    uint32_t y;
+
+
+    if (calibr->points_qty < 2) return 0;
+
+    if (x < calibr->x[0]) {
+        y = ((uint32_t)(calibr->x[0] - x) * calibr->slope[0]) >> calibr->slope_shift;
+        if (y >= calibr->y[0]) return 0;
+        return calibr->y[0] - (uint16_t)y;
+    }
+
+    low = 0;
+    high = calibr->points_qty - 1;
+    if (x >= calibr->x[high]) {
+        low = high - 1;
+    }
+    else {
+        // Find segment: x[low] <= x < x[low + 1]
+        while ((high - low) > 1) {
+            mid = (low + high) >> 1;
+            if (calibr->x[mid] <= x) low = mid;
+            else high = mid;
+        }
+    }
+
+    y = ((uint32_t)(x - calibr->x[low]) * calibr->slope[low]) >> calibr->slope_shift;
+    y += calibr->y[low];
+    if (y > 0xFFFF) y = 0xFFFF;
+
+    return (uint16_t)y;
+}
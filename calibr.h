@@ -0,0 +1,33 @@
+#ifndef _CALIBR_H_
+#define _CALIBR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "eeprom_record.h"
+
+
+#define CALIBR_MAX_POINTS    (8)
+// eeprom_record payload: x, y, points qty - the head of calibr_t
+#define CALIBR_RECORD_SIZE   ((CALIBR_MAX_POINTS * 4) + 1)
+// Raw EEPROM block (import): points qty (1 byte) + points (x, y) BE - HHLL
+#define CALIBR_RAW_SIZE      (1 + (CALIBR_MAX_POINTS * 4))
+
+
+// Piecewise linear y(x), x strictly ascending, y non-decreasing
+typedef struct {
+    uint16_t x[CALIBR_MAX_POINTS];
+    uint16_t y[CALIBR_MAX_POINTS];
+    uint8_t points_qty;
+    uint8_t slope_shift;
+    uint16_t slope[CALIBR_MAX_POINTS - 1];   // (dy / dx) << slope_shift
+} calibr_t;
+
+
+extern bool calibr_load(calibr_t *calibr, eeprom_record_t *rec);
+extern void calibr_save(const calibr_t *calibr, eeprom_record_t *rec);
+extern bool calibr_load_raw(calibr_t *calibr, uint16_t ee_addr);
+extern bool calibr_update(calibr_t *calibr);
+extern uint16_t calibr_calc(const calibr_t *calibr, uint16_t x);
+
+
+#endif   // _CALIBR_H_
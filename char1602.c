@@ -9,8 +9,8 @@
 // Drive pins
 #define LCD1602_RS_SET   (GPIOD_SET(4))
 #define LCD1602_RS_RESET (GPIOD_RESET(4))
-#define LCD1602_RW_SET   (GPIOD_SET(2))
-#define LCD1602_RW_RESET (GPIOD_RESET(2))
+#define LCD1602_RW_SET   (GPIOD_SET(LCD1602_RW_GPIOD_PIN))
+#define LCD1602_RW_RESET (GPIOD_RESET(LCD1602_RW_GPIOD_PIN))
 #define LCD1602_E_SET    (GPIOC_SET(1))
 #define LCD1602_E_RESET  (GPIOC_RESET(1))
 
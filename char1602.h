@@ -4,6 +4,9 @@
 #include <stdint.h>
 
 
+#define LCD1602_RW_GPIOD_PIN (2)   // PD2, also INT0
+
+
 extern void lcd1602_init();
 extern void lcd1602_clear();
 extern void lcd1602_move_coursor(uint8_t x, uint8_t y);
@@ -4,9 +4,11 @@
 #include "cli_uart.h"
 #include "device_registers.h"
 #include "eeprom_driver.h"
+#include "fl_profile_store.h"
 
 
 static void cli_cmd_processing(void);
+static bool cli_fl_profile_cmd(void);
 static bool hex_text_to_u8(uint8_t *simw_ptr, uint8_t *result);
 static void u8_to_hex_text(uint8_t value, uint8_t *result);
 
@@ -68,8 +70,14 @@ static void cli_cmd_processing(void) {
 
         // ewAAAA XX[XX][XXXX] | erAAAA | edAAAA | eqAAAA  (all in HEX)  - read/write EEPROM
         // rwAAAA XX[XX][XXXX] | rrAAAA | rdAAAA | rqAAAA  (all in HEX)  - read/write RAM
+        // pq | prII | pn[NAME] | pvCCCCTTTT | pa | pwII | pdII | pmIIJJ  (numbers in HEX)  - fl profiles
+        // pc[QQ] | psKK[CCCCRRRRHHHH] | puKK[OOOOFFFF] | pe[DDDD]  (numbers in HEX)  - fl profile segments, dose
 
-        if (cli_uart_rx_buff[0] == 'e') {
+        if (cli_uart_rx_buff[0] == 'p') {
+            is_error = !cli_fl_profile_cmd();
+            goto end;
+        }
+        else if (cli_uart_rx_buff[0] == 'e') {
             reg_qty = DEVICE_EEPROM_REG_QTY;
             is_epprom_cmd = true;
         }
@@ -88,7 +96,7 @@ static void cli_cmd_processing(void) {
             
 
             if ((cli_uart_rx_buff[1] == 'r') && (cli_uart_rx_cnt == 6)) {
-                if (addr > reg_qty) goto end;
+                if (addr >= reg_qty) goto end;
                 
                 if (is_epprom_cmd) {
                     eeprom_driver_read(addr, 1, value);
@@ -148,7 +156,7 @@ static void cli_cmd_processing(void) {
             }
             else if (cli_uart_rx_buff[1] == 'w') {
                 if (cli_uart_rx_cnt == 9) {
-                    if (addr > reg_qty) goto end;
+                    if (addr >= reg_qty) goto end;
                     if (!hex_text_to_u8(&cli_uart_rx_buff[7], &value[0])) goto end;
 
                     if (is_epprom_cmd) {
@@ -235,6 +243,152 @@ end:
 
 
 
+// Profile edit buffer: pr loads an entry, pn / pv set the name and current_pct, time_s,
+// pa appends the buffer, pw replaces entry II. pq - entries qty, pd - delete, pm - move II to JJ.
+// Segments of the buffer: pc - qty (0 - constant pv profile), ps - current_pct, ramp_s, hold_s of
+// segment KK, pu - pulse_on_ms, pulse_off_ms, pe - dose target. Without values the command replies them.
+static bool cli_fl_profile_cmd(void) {
+    static fl_profile_t profile;
+    uint8_t idx, new_idx;
+    uint8_t value[6];
+    uint16_t *segment_value;
+    uint8_t values_qty;
+    uint8_t i;
+
+
+    if (cli_uart_rx_cnt < 2) return false;
+
+    switch (cli_uart_rx_buff[1]) {
+        case 'q':
+            if (cli_uart_rx_cnt != 2) return false;
+            u8_to_hex_text(fl_profile_store_qty(), &cli_uart_tx_buff[cli_uart_tx_size]);
+            cli_uart_tx_size += 2;
+            return true;
+
+        case 'r':
+            if (cli_uart_rx_cnt != 4) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[2], &idx)) return false;
+            if (!fl_profile_store_read(idx, &profile)) return false;
+            // BE - HHLL
+            u8_to_hex_text((profile.current_pct >> 8), &cli_uart_tx_buff[cli_uart_tx_size]);
+            u8_to_hex_text(profile.current_pct, &cli_uart_tx_buff[cli_uart_tx_size + 2]);
+            u8_to_hex_text((profile.time_s >> 8), &cli_uart_tx_buff[cli_uart_tx_size + 4]);
+            u8_to_hex_text(profile.time_s, &cli_uart_tx_buff[cli_uart_tx_size + 6]);
+            cli_uart_tx_size += 8;
+            return true;
+
+        case 'n':
+            if (cli_uart_rx_cnt == 2) {
+                for (i = 0; i < FL_PROFILE_NAME_SIZE; i++) {
+                    cli_uart_tx_buff[cli_uart_tx_size] = (profile.name[i] == 0xFF) ? ' ' : profile.name[i];
+                    cli_uart_tx_size++;
+                }
+                return true;
+            }
+            if (cli_uart_rx_cnt > (2 + FL_PROFILE_NAME_SIZE)) return false;
+            for (i = 0; i < FL_PROFILE_NAME_SIZE; i++) {
+                if ((i + 2) < cli_uart_rx_cnt) profile.name[i] = cli_uart_rx_buff[i + 2];
+                else profile.name[i] = ' ';
+            }
+            break;
+
+        case 'v':
+            if (cli_uart_rx_cnt != 10) return false;
+            for (i = 0; i < 4; i++) {
+                if (!hex_text_to_u8(&cli_uart_rx_buff[2 + (i * 2)], &value[i])) return false;
+            }
+            profile.current_pct = ((uint16_t)value[0] << 8) | value[1];
+            profile.time_s = ((uint16_t)value[2] << 8) | value[3];
+            break;
+
+        case 'c':
+            if (cli_uart_rx_cnt == 2) {
+                u8_to_hex_text(profile.segments_qty, &cli_uart_tx_buff[cli_uart_tx_size]);
+                cli_uart_tx_size += 2;
+                return true;
+            }
+            if (cli_uart_rx_cnt != 4) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[2], &idx) || (idx > FL_PROFILE_SEGMENTS_MAX)) return false;
+            profile.segments_qty = idx;
+            break;
+
+        case 'e':
+            // BE - HHLL
+            if (cli_uart_rx_cnt == 2) {
+                u8_to_hex_text((profile.dose_target >> 8), &cli_uart_tx_buff[cli_uart_tx_size]);
+                u8_to_hex_text(profile.dose_target, &cli_uart_tx_buff[cli_uart_tx_size + 2]);
+                cli_uart_tx_size += 4;
+                return true;
+            }
+            if (cli_uart_rx_cnt != 6) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[2], &value[0]) || !hex_text_to_u8(&cli_uart_rx_buff[4], &value[1])) return false;
+            profile.dose_target = ((uint16_t)value[0] << 8) | value[1];
+            break;
+
+        case 's':
+        case 'u':
+            if (cli_uart_rx_cnt < 4) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[2], &idx) || (idx >= FL_PROFILE_SEGMENTS_MAX)) return false;
+            if (cli_uart_rx_buff[1] == 's') {
+                segment_value = &profile.segments[idx].current_pct;   // current_pct, ramp_s, hold_s
+                values_qty = 3;
+            }
+            else {
+                segment_value = &profile.segments[idx].pulse_on_ms;   // pulse_on_ms, pulse_off_ms
+                values_qty = 2;
+            }
+            // BE - HHLL
+            if (cli_uart_rx_cnt == 4) {
+                for (i = 0; i < values_qty; i++) {
+                    u8_to_hex_text((segment_value[i] >> 8), &cli_uart_tx_buff[cli_uart_tx_size]);
+                    u8_to_hex_text(segment_value[i], &cli_uart_tx_buff[cli_uart_tx_size + 2]);
+                    cli_uart_tx_size += 4;
+                }
+                return true;
+            }
+            if (cli_uart_rx_cnt != (4 + (values_qty * 4))) return false;
+            for (i = 0; i < (values_qty * 2); i++) {
+                if (!hex_text_to_u8(&cli_uart_rx_buff[4 + (i * 2)], &value[i])) return false;
+            }
+            for (i = 0; i < values_qty; i++) segment_value[i] = ((uint16_t)value[i * 2] << 8) | value[(i * 2) + 1];
+            break;
+
+        case 'a':
+            if (cli_uart_rx_cnt != 2) return false;
+            if (!fl_profile_store_add(&profile)) return false;
+            break;
+
+        case 'w':
+        case 'd':
+            if (cli_uart_rx_cnt != 4) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[2], &idx)) return false;
+            if (cli_uart_rx_buff[1] == 'w') {
+                if (!fl_profile_store_replace(idx, &profile)) return false;
+            }
+            else {
+                if (!fl_profile_store_delete(idx)) return false;
+            }
+            break;
+
+        case 'm':
+            if (cli_uart_rx_cnt != 6) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[2], &idx)) return false;
+            if (!hex_text_to_u8(&cli_uart_rx_buff[4], &new_idx)) return false;
+            if (!fl_profile_store_move(idx, new_idx)) return false;
+            break;
+
+        default:
+            return false;
+    }
+
+    cli_uart_tx_buff[cli_uart_tx_size] = 'O';
+    cli_uart_tx_size++;
+    cli_uart_tx_buff[cli_uart_tx_size] = 'K';
+    cli_uart_tx_size++;
+    return true;
+}
+
+
 static bool hex_text_to_u8(uint8_t *simw_ptr, uint8_t *result) {
     uint8_t result_tmp;
 
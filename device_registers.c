@@ -3,12 +3,34 @@
 #include "device_registers.h"
 #include "error_handler.h"
 #include "gpio_driver.h"   ////dbg
+#include "led_driver.h"
+#include "fl_exposure.h"
+#include "fl_profile_store.h"
+#if (PHOTODIODE_EN != 0)
+#include "photodiode.h"
+#include "meas.h"
+#endif
+#if (HEATER_EN != 0)
+#include "heater_driver.h"
+#if (HEATER_AUTOTUNE_EN != 0)
+#include "heater_autotune.h"
+#endif
+#if (HEATER_PROFILE_EN != 0)
+#include "heater_profile.h"
+#endif
+#include "fan_driver.h"
+#include "heater_stand.h"
+#include "heater_calibr.h"
+#endif
 
 
 uint16_t drvice_reg_enc_test_0 = 100;   ////dbg
 uint16_t drvice_reg_enc_test_1 = 0;   ////dbg
 
 static uint8_t drvice_reg_cmd = 0;
+#if (HEATER_EN != 0) && ((HEATER_AUTOTUNE_EN == 0) || (HEATER_PROFILE_EN == 0))
+static uint8_t drvice_reg_none = 0;   // registers of the features left out of the build
+#endif
 
 
 // BE - HHLL
@@ -16,13 +38,172 @@ uint8_t *device_registers_ptr[DEVICE_RAM_REG_QTY] = {
     // 0
     (uint8_t*)&drvice_reg_cmd,
     // 1
-    (uint8_t*)&eh_state,
+    (uint8_t*)&eh_state + 0,   // low byte, high byte - register 35
     // 2
     (uint8_t*)&drvice_reg_enc_test_0 + 1,
     (uint8_t*)&drvice_reg_enc_test_0 + 0,
     // 4
     (uint8_t*)&drvice_reg_enc_test_1 + 1,
     (uint8_t*)&drvice_reg_enc_test_1 + 0,
+    #if (HEATER_EN != 0)
+    // 6
+    (uint8_t*)&heater[HEATER_MAIN].setup_temperature_c + 1,
+    (uint8_t*)&heater[HEATER_MAIN].setup_temperature_c + 0,
+    // 8
+    (uint8_t*)&heater[HEATER_MAIN].real_temperature_c + 1,
+    (uint8_t*)&heater[HEATER_MAIN].real_temperature_c + 0,
+    // 10
+    (uint8_t*)&heater[HEATER_MAIN].pid.kp + 1,
+    (uint8_t*)&heater[HEATER_MAIN].pid.kp + 0,
+    // 12
+    (uint8_t*)&heater[HEATER_MAIN].pid.ki + 1,
+    (uint8_t*)&heater[HEATER_MAIN].pid.ki + 0,
+    // 14
+    (uint8_t*)&heater[HEATER_MAIN].pid.kd + 1,
+    (uint8_t*)&heater[HEATER_MAIN].pid.kd + 0,
+    // 16
+    (uint8_t*)&heater[HEATER_MAIN].settling_time_100ms + 1,
+    (uint8_t*)&heater[HEATER_MAIN].settling_time_100ms + 0,
+    // 18
+    (uint8_t*)&heater[HEATER_MAIN].overshoot_c + 1,
+    (uint8_t*)&heater[HEATER_MAIN].overshoot_c + 0,
+    // 20
+    (uint8_t*)&heater[HEATER_MAIN].cal_ocr_minimal_ocr + 1,
+    (uint8_t*)&heater[HEATER_MAIN].cal_ocr_minimal_ocr + 0,
+    #if (HEATER_AUTOTUNE_EN != 0)
+    // 22
+    (uint8_t*)&heater_autotune_setpoint_c + 1,
+    (uint8_t*)&heater_autotune_setpoint_c + 0,
+    // 24
+    (uint8_t*)&heater_autotune_state,
+    #else
+    &drvice_reg_none,
+    &drvice_reg_none,
+    &drvice_reg_none,
+    #endif
+    // 25
+    (uint8_t*)&heater_tc_conv_cycles + 1,
+    (uint8_t*)&heater_tc_conv_cycles + 0,
+    // 27
+    (uint8_t*)&heater[HEATER_MAIN].out_mode,
+    // 28
+    (uint8_t*)&heater[HEATER_MAIN].ssr_window_ms + 1,
+    (uint8_t*)&heater[HEATER_MAIN].ssr_window_ms + 0,
+    #if (HEATER_PROFILE_EN != 0)
+    // 30
+    (uint8_t*)&heater_profile_idx,
+    // 31
+    (uint8_t*)&heater_profile_state,
+    // 32
+    (uint8_t*)&heater_profile_segment,
+    // 33
+    (uint8_t*)&heater_profile_ramp_ff + 1,
+    (uint8_t*)&heater_profile_ramp_ff + 0,
+    #else
+    &drvice_reg_none,
+    &drvice_reg_none,
+    &drvice_reg_none,
+    &drvice_reg_none,
+    &drvice_reg_none,
+    #endif
+    // 35
+    (uint8_t*)&eh_state + 1,
+    // 36
+    (uint8_t*)&fan_setup_pct,
+    // 37
+    (uint8_t*)&fan_state,
+    // 38
+    (uint8_t*)&fan_rpm + 1,
+    (uint8_t*)&fan_rpm + 0,
+    // 40
+    (uint8_t*)&fan_max_rpm + 1,
+    (uint8_t*)&fan_max_rpm + 0,
+    // 42
+    (uint8_t*)&heater_stand_state,
+    // 43
+    (uint8_t*)&heater_stand_setback_delay_s + 1,
+    (uint8_t*)&heater_stand_setback_delay_s + 0,
+    // 45
+    (uint8_t*)&heater_stand_sleep_delay_s + 1,
+    (uint8_t*)&heater_stand_sleep_delay_s + 0,
+    // 47
+    (uint8_t*)&heater_stand_setback_c + 1,
+    (uint8_t*)&heater_stand_setback_c + 0,
+    // 49
+    (uint8_t*)&heater_calibr_state,
+    // 50
+    (uint8_t*)&heater_calibr_point,
+    // 51
+    (uint8_t*)&heater_calibr_points_qty,
+    // 52
+    (uint8_t*)&heater_calibr_ref_c + 1,
+    (uint8_t*)&heater_calibr_ref_c + 0,
+    // 54
+    (uint8_t*)&heater_calibr_raw + 1,
+    (uint8_t*)&heater_calibr_raw + 0,
+    // 56
+    (uint8_t*)&heater_calibr_target_c[0] + 1,
+    (uint8_t*)&heater_calibr_target_c[0] + 0,
+    (uint8_t*)&heater_calibr_target_c[1] + 1,
+    (uint8_t*)&heater_calibr_target_c[1] + 0,
+    (uint8_t*)&heater_calibr_target_c[2] + 1,
+    (uint8_t*)&heater_calibr_target_c[2] + 0,
+    (uint8_t*)&heater_calibr_target_c[3] + 1,
+    (uint8_t*)&heater_calibr_target_c[3] + 0,
+    #if (HEATER_QTY > 1)
+    // 64
+    (uint8_t*)&heater[1].setup_temperature_c + 1,
+    (uint8_t*)&heater[1].setup_temperature_c + 0,
+    // 66
+    (uint8_t*)&heater[1].real_temperature_c + 1,
+    (uint8_t*)&heater[1].real_temperature_c + 0,
+    // 68
+    (uint8_t*)&heater[1].pid.kp + 1,
+    (uint8_t*)&heater[1].pid.kp + 0,
+    // 70
+    (uint8_t*)&heater[1].pid.ki + 1,
+    (uint8_t*)&heater[1].pid.ki + 0,
+    // 72
+    (uint8_t*)&heater[1].pid.kd + 1,
+    (uint8_t*)&heater[1].pid.kd + 0,
+    // 74
+    (uint8_t*)&heater[1].cal_ocr_minimal_ocr + 1,
+    (uint8_t*)&heater[1].cal_ocr_minimal_ocr + 0,
+    // 76
+    (uint8_t*)&heater[1].out_mode,
+    // 77
+    (uint8_t*)&heater[1].ssr_window_ms + 1,
+    (uint8_t*)&heater[1].ssr_window_ms + 0,
+    // 79
+    (uint8_t*)&heater_calibr_heater_idx,
+    #endif
+    #endif
+    // DEVICE_RAM_REG_FL_EXPOSURE: last program, requested and actual (run start - LED cutoff) time
+    (uint8_t*)&fl_exposure_last_requested_ms + 3,
+    (uint8_t*)&fl_exposure_last_requested_ms + 2,
+    (uint8_t*)&fl_exposure_last_requested_ms + 1,
+    (uint8_t*)&fl_exposure_last_requested_ms + 0,
+    (uint8_t*)&fl_exposure_last_actual_ms + 3,
+    (uint8_t*)&fl_exposure_last_actual_ms + 2,
+    (uint8_t*)&fl_exposure_last_actual_ms + 1,
+    (uint8_t*)&fl_exposure_last_actual_ms + 0,
+    // +8: last program dose, current dose (0.1 A*s)
+    (uint8_t*)&fl_exposure_last_dose + 1,
+    (uint8_t*)&fl_exposure_last_dose + 0,
+    (uint8_t*)&fl_exposure_dose + 1,
+    (uint8_t*)&fl_exposure_dose + 0,
+    // +12: legacy fl profiles lost by the migration to the store
+    (uint8_t*)&fl_profile_store_lost_qty,
+    #if (PHOTODIODE_EN != 0)
+    // DEVICE_RAM_REG_PHOTODIODE: regulation mode, light full scale, irradiance (uW/cm2), raw
+    (uint8_t*)&led_reg_mode,
+    (uint8_t*)&led_light_max + 1,
+    (uint8_t*)&led_light_max + 0,
+    (uint8_t*)&photodiode_irradiance + 1,
+    (uint8_t*)&photodiode_irradiance + 0,
+    (uint8_t*)&meas_adc_data.channel_name.photodiode + 1,
+    (uint8_t*)&meas_adc_data.channel_name.photodiode + 0,
+    #endif
 };
 
 
@@ -31,11 +212,57 @@ void drvice_registers_proc(void) {
         case 0:
             break;
         
-        case 1:
+        #if (HEATER_EN != 0)
+        #if (HEATER_AUTOTUNE_EN != 0)
+        case DEVICE_REG_CMD_HEATER_AUTOTUNE_START:
+            heater_autotune_start();
             break;
 
-        case 2:
+        case DEVICE_REG_CMD_HEATER_AUTOTUNE_ABORT:
+            heater_autotune_abort();
             break;
+        #endif
+
+        #if (HEATER_PROFILE_EN != 0)
+        case DEVICE_REG_CMD_HEATER_PROFILE_START:
+            heater_profile_start();
+            break;
+
+        case DEVICE_REG_CMD_HEATER_PROFILE_ABORT:
+            heater_profile_abort();
+            break;
+        #endif
+
+        case DEVICE_REG_CMD_HEATER_CALIBR_START:
+            heater_calibr_start();
+            break;
+
+        case DEVICE_REG_CMD_HEATER_CALIBR_POINT:
+            heater_calibr_point_ref();
+            break;
+
+        case DEVICE_REG_CMD_HEATER_CALIBR_ABORT:
+            heater_calibr_abort();
+            break;
+
+        case DEVICE_REG_CMD_HEATER_PARAMS_SAVE:
+            heater_params_save_all();
+            break;
+        #endif
+
+        case DEVICE_REG_CMD_LED_CALIBR_IMPORT:
+            led_driver_calibr_import();
+            break;
+
+        #if (PHOTODIODE_EN != 0)
+        case DEVICE_REG_CMD_PHOTODIODE_CALIBR_IMPORT:
+            photodiode_calibr_import();
+            break;
+
+        case DEVICE_REG_CMD_LED_PARAMS_SAVE:
+            led_driver_params_save();
+            break;
+        #endif
 
         default:
             break;
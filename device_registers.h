@@ -1,21 +1,38 @@
 #include <stdint.h>
+#include "eeprom_partitions.h"
 
 
 #ifndef DEVICE_REGISTERS
 #define DEVICE_REGISTERS
 
 
-#define DEVICE_EEPROM_REG_QTY                (1024)
-#define DEVICE_RAM_REG_QTY                   (15)
-
-#define EE_ADDR_CALIBR_TC_T1_MEAS_RAW        (0)
-#define EE_ADDR_CALIBR_TC_T2_MEAS_RAW        (2)
-#define EE_ADDR_OCR_CALIBR_K                 (4)
-#define EE_ADDR_OCR_CALIBR_MINIMAL_OCR       (6)
-#define EE_ADDR_LAST_TEMP_SETUP_BUFF         (0x0100)
-#define EE_LAST_TEMP_SETUP_BUFF_SIZE         (0xFF)
-#define EE_ADDR_LAST_FUN_SETUP_BUFF          (0x0200)
-#define EE_LAST_FUM_SETUP_BUFF_SIZE          (0xFF)
+#define DEVICE_EEPROM_REG_QTY                (EE_SIZE)
+#if (HEATER_EN != 0) && (HEATER_QTY > 1)
+#define DEVICE_RAM_REG_FL_EXPOSURE           (80)
+#elif (HEATER_EN != 0)
+#define DEVICE_RAM_REG_FL_EXPOSURE           (64)
+#else
+#define DEVICE_RAM_REG_FL_EXPOSURE           (6)
+#endif
+#if (PHOTODIODE_EN != 0)
+#define DEVICE_RAM_REG_PHOTODIODE            (DEVICE_RAM_REG_FL_EXPOSURE + 13)
+#define DEVICE_RAM_REG_QTY                   (DEVICE_RAM_REG_PHOTODIODE + 7)    // photodiode block is the last one
+#else
+#define DEVICE_RAM_REG_QTY                   (DEVICE_RAM_REG_FL_EXPOSURE + 13)   // fl exposure block is the last one
+#endif
+
+// drvice_reg_cmd (RAM register 0) commands
+#define DEVICE_REG_CMD_HEATER_AUTOTUNE_START (1)
+#define DEVICE_REG_CMD_HEATER_AUTOTUNE_ABORT (2)
+#define DEVICE_REG_CMD_HEATER_PROFILE_START  (3)
+#define DEVICE_REG_CMD_HEATER_PROFILE_ABORT  (4)
+#define DEVICE_REG_CMD_HEATER_CALIBR_START   (5)
+#define DEVICE_REG_CMD_HEATER_CALIBR_POINT   (6)   // reference temperature of the point is in its register
+#define DEVICE_REG_CMD_HEATER_CALIBR_ABORT   (7)
+#define DEVICE_REG_CMD_HEATER_PARAMS_SAVE    (8)   // minimal OCR, PID, output mode registers of all heaters to EEPROM
+#define DEVICE_REG_CMD_LED_CALIBR_IMPORT     (9)   // EE_PART_CALIBR_LED_RAW block -> LED current calibration
+#define DEVICE_REG_CMD_PHOTODIODE_CALIBR_IMPORT (10)   // EE_PART_CALIBR_LED_RAW block -> photodiode calibration
+#define DEVICE_REG_CMD_LED_PARAMS_SAVE       (11)  // LED regulation mode, light full scale registers to EEPROM
 
 
 extern uint8_t *device_registers_ptr[DEVICE_RAM_REG_QTY];
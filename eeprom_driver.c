@@ -1,20 +1,80 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "eeprom_driver.h"
 
 
+#ifdef __AVR_ATmega8__
+#define EEPROM_DRIVER_WRITE_BUSY (EECR & (1 << EEWE))
+#else
+#define EEPROM_DRIVER_WRITE_BUSY (EECR & (1 << EEPE))
+#endif
+
+
+typedef struct {
+    uint16_t addr;
+    uint8_t data;
+} eeprom_driver_write_t;
+
+typedef struct {
+    uint16_t addr;
+    uint16_t size;
+    uint8_t *buff;
+} eeprom_driver_cache_t;
+
+
+static eeprom_driver_write_t eeprom_driver_queue[EEPROM_DRIVER_QUEUE_SIZE];
+static volatile uint8_t eeprom_driver_queue_head;
+static volatile uint8_t eeprom_driver_queue_qty;
+static eeprom_driver_cache_t eeprom_driver_cache[EEPROM_DRIVER_CACHE_QTY];
+static uint8_t eeprom_driver_cache_qty;
+
+
+
+
+static uint8_t *eeprom_driver_cache_get(uint16_t addr);
+
+
+
+
 void eeprom_driver_read_8(uint16_t addr, uint8_t *data) {
-    #ifdef __AVR_ATmega8__
-    while(EECR & (1 << EEWE)) ;
-    EEAR = addr;
-    EECR |= (1 << EERE);
-    *data = EEDR;
-    #else
-    while(EECR & (1 << EEPE)) ;
-    EEAR = addr;
-    EECR |= (1 << EERE);
-    *data = EEDR;
-    #endif
+    uint8_t i, idx;
+    uint8_t *cache;
+
+
+    cache = eeprom_driver_cache_get(addr);
+    if (cache != 0) {
+        *data = *cache;
+        return;
+    }
+
+    while (1) {
+        cli();
+
+        // Newest queued write of the address
+        i = eeprom_driver_queue_qty;
+        while (i > 0) {
+            i--;
+            idx = (eeprom_driver_queue_head + i) % EEPROM_DRIVER_QUEUE_SIZE;
+            if (eeprom_driver_queue[idx].addr == addr) {
+                *data = eeprom_driver_queue[idx].data;
+                sei();
+                return;
+            }
+        }
+
+        // EEAR can't be changed while a byte is programmed
+        if (!EEPROM_DRIVER_WRITE_BUSY) {
+            EEAR = addr;
+            EECR |= (1 << EERE);
+            *data = EEDR;
+            sei();
+            return;
+        }
+
+        sei();
+    }
 }
 
 
@@ -34,6 +94,18 @@ void eeprom_driver_read_16(uint16_t addr, uint16_t *data) {
 
 void eeprom_driver_read(uint16_t addr, uint8_t data_qty, uint8_t *data) {
     uint16_t addr_end;
+    uint8_t *cache;
+
+
+    // Block inside a cached region
+    cache = eeprom_driver_cache_get(addr);
+    if ((cache != 0) && (eeprom_driver_cache_get(addr + data_qty - 1) == (cache + data_qty - 1))) {
+        while (data_qty > 0) {
+            *data++ = *cache++;
+            data_qty--;
+        }
+        return;
+    }
 
     addr_end = addr + data_qty;
     for ( ; addr < addr_end; addr++) {
@@ -43,20 +115,27 @@ void eeprom_driver_read(uint16_t addr, uint8_t data_qty, uint8_t *data) {
 }
 
 
+// Queued, returns at once unless the queue is full. Unchanged bytes are not programmed.
 void eeprom_driver_write_8(uint16_t addr, uint8_t data) {
-    #ifdef __AVR_ATmega8__
-    while(EECR & (1 << EEWE)) ;
-    EEAR = addr;
-    EEDR = data;
-    EECR |= (1 << EEMWE);    // must be set after EEWE !!!
-    EECR |= (1 << EEWE);
-    #else
-    while(EECR & (1 << EEPE)) ;
-    EEAR = addr;
-    EEDR = data;
-    EECR |= (1 << EEMPE);    // must be set after EEPE !!!
-    EECR |= (1 << EEPE);
-    #endif
+    uint8_t idx;
+    uint8_t *cache;
+
+
+    cache = eeprom_driver_cache_get(addr);
+    if (cache != 0) {
+        if (*cache == data) return;
+        *cache = data;
+    }
+
+    while (eeprom_driver_queue_qty >= EEPROM_DRIVER_QUEUE_SIZE) ;
+
+    cli();
+    idx = (eeprom_driver_queue_head + eeprom_driver_queue_qty) % EEPROM_DRIVER_QUEUE_SIZE;
+    eeprom_driver_queue[idx].addr = addr;
+    eeprom_driver_queue[idx].data = data;
+    eeprom_driver_queue_qty++;
+    EECR |= (1 << EERIE);
+    sei();
 }
 
 
@@ -83,3 +162,82 @@ void eeprom_driver_write(uint16_t addr, uint8_t data_qty, const uint8_t *data) {
         data++;
     }
 }
+
+
+// Loads the region in one block read, then reads of it are served from buff
+bool eeprom_driver_cache_add(uint16_t addr, uint16_t size, uint8_t *buff) {
+    uint16_t i;
+
+
+    if (eeprom_driver_cache_qty >= EEPROM_DRIVER_CACHE_QTY) return false;
+
+    for (i = 0; i < size; i++) eeprom_driver_read_8((addr + i), &buff[i]);
+
+    eeprom_driver_cache[eeprom_driver_cache_qty].addr = addr;
+    eeprom_driver_cache[eeprom_driver_cache_qty].size = size;
+    eeprom_driver_cache[eeprom_driver_cache_qty].buff = buff;
+    eeprom_driver_cache_qty++;
+    return true;
+}
+
+
+// All queued writes are programmed
+bool eeprom_driver_is_idle(void) {
+    return ((eeprom_driver_queue_qty == 0) && !EEPROM_DRIVER_WRITE_BUSY);
+}
+
+
+// Barrier for the callers that need the data in EEPROM (before reset, power down)
+void eeprom_driver_flush(void) {
+    while (!eeprom_driver_is_idle()) ;
+}
+
+
+
+
+static uint8_t *eeprom_driver_cache_get(uint16_t addr) {
+    uint8_t i;
+
+
+    for (i = 0; i < eeprom_driver_cache_qty; i++) {
+        if ((addr >= eeprom_driver_cache[i].addr) && ((addr - eeprom_driver_cache[i].addr) < eeprom_driver_cache[i].size)) {
+            return &eeprom_driver_cache[i].buff[addr - eeprom_driver_cache[i].addr];
+        }
+    }
+    return 0;
+}
+
+
+
+
+// Programs the next queued byte that differs from the EEPROM content, EEPROM is ready (~8.5 ms per byte)
+#ifdef __AVR_ATmega8__
+ISR(EE_RDY_vect) {
+#else
+ISR(EE_READY_vect) {
+#endif
+    eeprom_driver_write_t *write;
+
+
+    while (eeprom_driver_queue_qty != 0) {
+        write = &eeprom_driver_queue[eeprom_driver_queue_head];
+        eeprom_driver_queue_head = (eeprom_driver_queue_head + 1) % EEPROM_DRIVER_QUEUE_SIZE;
+        eeprom_driver_queue_qty--;
+
+        EEAR = write->addr;
+        EECR |= (1 << EERE);
+        if (EEDR == write->data) continue;
+
+        EEDR = write->data;
+        #ifdef __AVR_ATmega8__
+        EECR |= (1 << EEMWE);    // must be set after EEWE !!!
+        EECR |= (1 << EEWE);
+        #else
+        EECR |= (1 << EEMPE);    // must be set after EEPE !!!
+        EECR |= (1 << EEPE);
+        #endif
+        return;
+    }
+
+    EECR &= ~(1 << EERIE);
+}
@@ -1,16 +1,26 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include <avr/io.h>
 
 #ifndef EEPROM_DRIVER_H
 #define EEPROM_DRIVER_H
 
 
+// Writes are queued and programmed one byte per EE_READY irq, reads see the queued data
+#define EEPROM_DRIVER_QUEUE_SIZE (32)   // bytes, a write to a full queue waits for a free slot
+// RAM mirrors of the hot regions, buffers are owned by the clients
+#define EEPROM_DRIVER_CACHE_QTY  (2)
+
+
 extern void eeprom_driver_read_8(uint16_t addr, uint8_t *data);
 extern void eeprom_driver_read_16(uint16_t addr, uint16_t *data);
 extern void eeprom_driver_read(uint16_t addr, uint8_t data_qty, uint8_t *data);
 extern void eeprom_driver_write_8(uint16_t addr, uint8_t data);
 extern void eeprom_driver_write_16(uint16_t addr, uint16_t data);
 extern void eeprom_driver_write(uint16_t addr, uint8_t data_qty, const uint8_t *data);
+extern bool eeprom_driver_cache_add(uint16_t addr, uint16_t size, uint8_t *buff);
+extern bool eeprom_driver_is_idle(void);
+extern void eeprom_driver_flush(void);
 
 
 #endif   // EEPROM_DRIVER_H
@@ -0,0 +1,121 @@
+#include "eeprom_log.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "eeprom_driver.h"
+#include "systimer.h"
+
+
+
+
+static uint8_t eeprom_log_read_seq(eeprom_log_t *log, uint8_t slot);
+static bool eeprom_log_is_next(eeprom_log_t *log, uint8_t slot, uint8_t base_seq);
+static void eeprom_log_commit(eeprom_log_t *log);
+
+
+
+
+// Finds the newest record: slots 0..newest continue the seq of slot 0, the rest is the previous lap
+// or erased - binary search over the ring
+void eeprom_log_init(eeprom_log_t *log, uint16_t ee_addr, uint16_t size) {
+    uint8_t base_seq;
+    uint8_t low, high, mid;
+    uint8_t slot, seq;
+
+
+    log->ee_addr = ee_addr;
+    size /= EEPROM_LOG_RECORD_SIZE;
+    if (size >= EEPROM_LOG_SEQ_MOD) size = EEPROM_LOG_SEQ_MOD - 1;
+    log->slots_qty = size;
+    log->is_pending = false;
+    log->is_valid = false;
+    log->newest_slot = log->slots_qty - 1;
+    log->newest_seq = EEPROM_LOG_SEQ_MOD - 1;
+
+    base_seq = eeprom_log_read_seq(log, 0);
+    if (base_seq < EEPROM_LOG_SEQ_MOD) {
+        low = 0;
+        high = log->slots_qty - 1;
+        while (low < high) {
+            mid = (low + high + 1) >> 1;
+            if (eeprom_log_is_next(log, mid, base_seq)) low = mid;
+            else high = mid - 1;
+        }
+        log->newest_slot = low;
+        log->newest_seq = (base_seq + low) % EEPROM_LOG_SEQ_MOD;
+        log->is_valid = true;
+    }
+    else {
+        // Slot 0 is erased or torn at the lap start: the newest one is the last valid slot of the previous lap
+        for (slot = log->slots_qty - 1; slot > 0; slot--) {
+            seq = eeprom_log_read_seq(log, slot);
+            if (seq < EEPROM_LOG_SEQ_MOD) {
+                log->newest_slot = slot;
+                log->newest_seq = seq;
+                log->is_valid = true;
+                break;
+            }
+        }
+    }
+
+    if (log->is_valid) eeprom_driver_read_16((log->ee_addr + ((uint16_t)log->newest_slot * EEPROM_LOG_RECORD_SIZE)), &log->value);
+}
+
+
+bool eeprom_log_get(eeprom_log_t *log, uint16_t *value) {
+    if (log->is_pending) *value = log->pending_value;
+    else if (log->is_valid) *value = log->value;
+    else return false;
+    return true;
+}
+
+
+// Deferred: fast changes (encoder turns) are coalesced into one record
+void eeprom_log_set(eeprom_log_t *log, uint16_t value) {
+    if (log->is_pending && (log->pending_value == value)) return;
+    if (!log->is_pending && log->is_valid && (log->value == value)) return;
+
+    log->pending_value = value;
+    log->is_pending = true;
+    log->commit_timer = systimer_set_ms(EEPROM_LOG_COMMIT_DELAY_MS);
+}
+
+
+void eeprom_log_process(eeprom_log_t *log) {
+    if (!log->is_pending || !systimer_triggered_ms(log->commit_timer)) return;
+    log->is_pending = false;
+    if (log->is_valid && (log->value == log->pending_value)) return;
+    eeprom_log_commit(log);
+}
+
+
+
+
+static uint8_t eeprom_log_read_seq(eeprom_log_t *log, uint8_t slot) {
+    uint8_t seq;
+
+
+    eeprom_driver_read_8((log->ee_addr + ((uint16_t)slot * EEPROM_LOG_RECORD_SIZE) + 2), &seq);
+    return seq;
+}
+
+
+static bool eeprom_log_is_next(eeprom_log_t *log, uint8_t slot, uint8_t base_seq) {
+    return (eeprom_log_read_seq(log, slot) == ((base_seq + slot) % EEPROM_LOG_SEQ_MOD));
+}
+
+
+// Value first, seq last (EEPROM writes are programmed in order)
+static void eeprom_log_commit(eeprom_log_t *log) {
+    uint16_t addr;
+
+
+    log->newest_slot++;
+    if (log->newest_slot >= log->slots_qty) log->newest_slot = 0;
+    log->newest_seq = (log->newest_seq + 1) % EEPROM_LOG_SEQ_MOD;
+    log->value = log->pending_value;
+    log->is_valid = true;
+
+    addr = log->ee_addr + ((uint16_t)log->newest_slot * EEPROM_LOG_RECORD_SIZE);
+    eeprom_driver_write_16(addr, log->value);
+    eeprom_driver_write_8((addr + 2), log->newest_seq);
+}
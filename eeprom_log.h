@@ -0,0 +1,35 @@
+#ifndef _EEPROM_LOG_H_
+#define _EEPROM_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "systimer.h"
+
+
+// Wear-leveled ring of records: value (BE - HHLL), seq. Seq is written last and counts modulo
+// EEPROM_LOG_SEQ_MOD, so an erased (0xFF) or torn record never continues the sequence.
+#define EEPROM_LOG_RECORD_SIZE     (3)
+#define EEPROM_LOG_SEQ_MOD         (255)
+#define EEPROM_LOG_COMMIT_DELAY_MS (3000)   // value must be stable this long before it is written
+
+
+typedef struct {
+    uint16_t ee_addr;
+    uint8_t slots_qty;
+    uint8_t newest_slot;
+    uint8_t newest_seq;
+    bool is_valid;
+    uint16_t value;           // committed
+    uint16_t pending_value;
+    bool is_pending;
+    timer_t commit_timer;
+} eeprom_log_t;
+
+
+extern void eeprom_log_init(eeprom_log_t *log, uint16_t ee_addr, uint16_t size);
+extern bool eeprom_log_get(eeprom_log_t *log, uint16_t *value);
+extern void eeprom_log_set(eeprom_log_t *log, uint16_t value);
+extern void eeprom_log_process(eeprom_log_t *log);
+
+
+#endif   // _EEPROM_LOG_H_
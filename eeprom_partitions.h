@@ -0,0 +1,155 @@
+#ifndef _EEPROM_PARTITIONS_H_
+#define _EEPROM_PARTITIONS_H_
+
+#include <avr/io.h>
+#include "eeprom_record.h"
+#include "eeprom_log.h"
+#include "calibr.h"
+
+
+// EEPROM partition table, in address order. Every partition is checked against the next one below,
+// a new partition must be added to the table and to the checks. The low part up to EE_PART_FL_PROFILES
+// is common (heater partitions are reserved in the heater-less build), the upper part is per build.
+#define EE_SIZE                          (E2END + 1)   // atmega328p: 1024, EEAR wraps above
+
+#define EE_PART_SETTINGS_ADDR            (0x0000)   // loose settings, BE - HHLL, see EE_ADDR_*
+#define EE_PART_SETTINGS_SIZE            (0x0020)
+#define EE_PART_HEATER_PARAMS_ADDR       (0x0020)   // record, EE_REC_HEATER_PARAMS_SIZE
+#define EE_PART_HEATER_PARAMS_SIZE       (EEPROM_RECORD_AB_SIZE(EE_REC_HEATER_PARAMS_SIZE))
+#define EE_PART_CALIBR_LED_RAW_ADDR      (0x0040)   // raw calibr block (qty + BE points), imported into EE_PART_CALIBR_LED or _PHOTODIODE
+#define EE_PART_CALIBR_LED_RAW_SIZE      (CALIBR_RAW_SIZE)
+// 0x0061..0x007F is free, the log rings were there on the atmega8
+#define EE_PART_FL_LEGACY_ADDR           (0x0080)   // fixed fl profile table of the old firmware, read by the migration only
+#define EE_PART_FL_LEGACY_SIZE           (0x0090)
+#define EE_PART_FL_PROFILES_ADDR         (0x0110)   // fl_profile_store: directory record + entries heap
+#if (HEATER_EN != 0) && (HEATER_QTY > 1)
+#define EE_PART_FL_PROFILES_SIZE         (0x0132)   // 33 chunks
+#define EE_PART_CALIBR_LED_ADDR          (0x0242)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_LED_SIZE          (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_CALIBR_HEATER_TC_ADDR    (0x028C)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_HEATER_TC_SIZE    (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_HEATER_PROFILES_ADDR     (0x02D6)   // HEATER_PROFILE_QTY * HEATER_PROFILE_EE_BLOCK_SIZE
+#define EE_PART_HEATER_PROFILES_SIZE     (0x0025)
+#define EE_PART_HEATER_1_PARAMS_ADDR     (0x02FB)   // second heater, record
+#define EE_PART_HEATER_1_PARAMS_SIZE     (EEPROM_RECORD_AB_SIZE(EE_REC_HEATER_PARAMS_SIZE))
+#define EE_PART_CALIBR_HEATER_1_TC_ADDR  (0x031B)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_HEATER_1_TC_SIZE  (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_LOG_SLOTS_QTY            (25)
+#elif (HEATER_EN != 0)
+#define EE_PART_FL_PROFILES_SIZE         (0x014A)   // 36 chunks
+#define EE_PART_CALIBR_LED_ADDR          (0x025A)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_LED_SIZE          (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_CALIBR_HEATER_TC_ADDR    (0x02A4)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_HEATER_TC_SIZE    (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_HEATER_PROFILES_ADDR     (0x02EE)   // HEATER_PROFILE_QTY * HEATER_PROFILE_EE_BLOCK_SIZE
+#define EE_PART_HEATER_PROFILES_SIZE     (0x004A)
+#define EE_PART_LOG_SLOTS_QTY            (33)
+#endif
+#if (HEATER_EN != 0)
+// Log rings at the EEPROM end. A cell is written once per EE_PART_LOG_SLOTS_QTY committed changes.
+#define EE_PART_LAST_TEMP_LOG_ADDR       (EE_PART_LAST_FAN_LOG_ADDR - EE_PART_LAST_TEMP_LOG_SIZE)   // eeprom_log ring
+#define EE_PART_LAST_TEMP_LOG_SIZE       (EE_PART_LOG_SLOTS_QTY * EEPROM_LOG_RECORD_SIZE)
+#define EE_PART_LAST_FAN_LOG_ADDR        (EE_SIZE - EE_PART_LAST_FAN_LOG_SIZE)   // eeprom_log ring
+#define EE_PART_LAST_FAN_LOG_SIZE        (EE_PART_LOG_SLOTS_QTY * EEPROM_LOG_RECORD_SIZE)
+#define EE_PART_USED_END                 (EE_PART_END(EE_PART_LAST_FAN_LOG))
+#else
+// Placed down from the EEPROM end, the fl profiles take the rest (0x024C, 64 chunks).
+// Photodiode (PHOTODIODE_EN) partitions are reserved without it.
+#define EE_PART_FL_PROFILES_SIZE         (EE_PART_CALIBR_LED_ADDR - EE_PART_FL_PROFILES_ADDR)
+#define EE_PART_CALIBR_LED_ADDR          (EE_PART_CALIBR_PHOTODIODE_ADDR - EE_PART_CALIBR_LED_SIZE)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_LED_SIZE          (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_CALIBR_PHOTODIODE_ADDR   (EE_PART_LED_PARAMS_ADDR - EE_PART_CALIBR_PHOTODIODE_SIZE)   // record, CALIBR_RECORD_SIZE
+#define EE_PART_CALIBR_PHOTODIODE_SIZE   (EEPROM_RECORD_AB_SIZE(CALIBR_RECORD_SIZE))
+#define EE_PART_LED_PARAMS_ADDR          (EE_SIZE - EE_PART_LED_PARAMS_SIZE)   // record, EE_REC_LED_PARAMS_SIZE
+#define EE_PART_LED_PARAMS_SIZE          (EEPROM_RECORD_AB_SIZE(EE_REC_LED_PARAMS_SIZE))
+#define EE_PART_USED_END                 (EE_PART_END(EE_PART_LED_PARAMS))
+#endif
+
+// Record payloads
+#define EE_REC_HEATER_PARAMS_SIZE        (12)   // heater_params_t
+#define EE_REC_HEATER_PARAMS_VERSION     (1)
+#define EE_REC_CALIBR_VERSION            (1)
+#define EE_REC_LED_PARAMS_SIZE           (4)    // led_params_t
+#define EE_REC_LED_PARAMS_VERSION        (1)
+
+// Settings partition
+#define EE_ADDR_CALIBR_TC_T1_MEAS_RAW        (0)    // legacy two-point calibration, used while there is no record
+#define EE_ADDR_CALIBR_TC_T2_MEAS_RAW        (2)
+#define EE_ADDR_OCR_CALIBR_MINIMAL_OCR       (6)    // legacy heater params, imported into the record once
+#define EE_ADDR_PID_KP                       (8)
+#define EE_ADDR_PID_KI                       (10)
+#define EE_ADDR_PID_KD                       (12)
+#define EE_ADDR_HEATER_OUT_MODE              (14)
+#define EE_ADDR_HEATER_SSR_WINDOW_MS         (16)
+#define EE_ADDR_HEATER_PROFILE_RAMP_FF       (18)
+#define EE_ADDR_FAN_MAX_RPM                  (20)
+#define EE_ADDR_HEATER_STAND_SETBACK_DELAY_S (22)
+#define EE_ADDR_HEATER_STAND_SLEEP_DELAY_S   (24)
+#define EE_ADDR_HEATER_STAND_SETBACK_C       (26)
+#define EE_ADDR_BOARD_T_UPPER_C              (28)
+#define EE_ADDR_BOARD_T_CRIT_C               (30)
+
+
+#define EE_PART_END(part)            (part##_ADDR + part##_SIZE)
+#define EE_PART_OVERLAP(part, next)  (EE_PART_END(part) > next##_ADDR)
+
+#if EE_PART_OVERLAP(EE_PART_SETTINGS, EE_PART_HEATER_PARAMS)
+#error "eeprom_partitions: EE_PART_SETTINGS overlaps EE_PART_HEATER_PARAMS"
+#endif
+#if EE_PART_OVERLAP(EE_PART_HEATER_PARAMS, EE_PART_CALIBR_LED_RAW)
+#error "eeprom_partitions: EE_PART_HEATER_PARAMS overlaps EE_PART_CALIBR_LED_RAW"
+#endif
+#if EE_PART_OVERLAP(EE_PART_CALIBR_LED_RAW, EE_PART_FL_LEGACY)
+#error "eeprom_partitions: EE_PART_CALIBR_LED_RAW overlaps EE_PART_FL_LEGACY"
+#endif
+#if EE_PART_OVERLAP(EE_PART_FL_LEGACY, EE_PART_FL_PROFILES)
+#error "eeprom_partitions: EE_PART_FL_LEGACY overlaps EE_PART_FL_PROFILES"
+#endif
+#if EE_PART_OVERLAP(EE_PART_FL_PROFILES, EE_PART_CALIBR_LED)
+#error "eeprom_partitions: EE_PART_FL_PROFILES overlaps EE_PART_CALIBR_LED"
+#endif
+#if (HEATER_EN != 0)
+#if EE_PART_OVERLAP(EE_PART_CALIBR_LED, EE_PART_CALIBR_HEATER_TC)
+#error "eeprom_partitions: EE_PART_CALIBR_LED overlaps EE_PART_CALIBR_HEATER_TC"
+#endif
+#if EE_PART_OVERLAP(EE_PART_CALIBR_HEATER_TC, EE_PART_HEATER_PROFILES)
+#error "eeprom_partitions: EE_PART_CALIBR_HEATER_TC overlaps EE_PART_HEATER_PROFILES"
+#endif
+#endif
+#if (HEATER_EN != 0) && (HEATER_QTY > 1)
+#if EE_PART_OVERLAP(EE_PART_HEATER_PROFILES, EE_PART_HEATER_1_PARAMS)
+#error "eeprom_partitions: EE_PART_HEATER_PROFILES overlaps EE_PART_HEATER_1_PARAMS"
+#endif
+#if EE_PART_OVERLAP(EE_PART_HEATER_1_PARAMS, EE_PART_CALIBR_HEATER_1_TC)
+#error "eeprom_partitions: EE_PART_HEATER_1_PARAMS overlaps EE_PART_CALIBR_HEATER_1_TC"
+#endif
+#if EE_PART_OVERLAP(EE_PART_CALIBR_HEATER_1_TC, EE_PART_LAST_TEMP_LOG)
+#error "eeprom_partitions: EE_PART_CALIBR_HEATER_1_TC overlaps EE_PART_LAST_TEMP_LOG"
+#endif
+#elif (HEATER_EN != 0)
+#if EE_PART_OVERLAP(EE_PART_HEATER_PROFILES, EE_PART_LAST_TEMP_LOG)
+#error "eeprom_partitions: EE_PART_HEATER_PROFILES overlaps EE_PART_LAST_TEMP_LOG"
+#endif
+#endif
+#if (HEATER_EN != 0)
+#if EE_PART_OVERLAP(EE_PART_LAST_TEMP_LOG, EE_PART_LAST_FAN_LOG)
+#error "eeprom_partitions: EE_PART_LAST_TEMP_LOG overlaps EE_PART_LAST_FAN_LOG"
+#endif
+#endif
+#if (HEATER_EN == 0)
+#if EE_PART_OVERLAP(EE_PART_CALIBR_LED, EE_PART_CALIBR_PHOTODIODE)
+#error "eeprom_partitions: EE_PART_CALIBR_LED overlaps EE_PART_CALIBR_PHOTODIODE"
+#endif
+#if EE_PART_OVERLAP(EE_PART_CALIBR_PHOTODIODE, EE_PART_LED_PARAMS)
+#error "eeprom_partitions: EE_PART_CALIBR_PHOTODIODE overlaps EE_PART_LED_PARAMS"
+#endif
+#endif
+#if (EE_PART_USED_END > EE_SIZE)
+#error "eeprom_partitions: partitions do not fit EE_SIZE"
+#endif
+#if (PHOTODIODE_EN != 0) && (HEATER_EN != 0)
+#error "eeprom_partitions: photodiode partitions are in the heater-less layout only"
+#endif
+
+
+#endif   // _EEPROM_PARTITIONS_H_
@@ -0,0 +1,115 @@
+#include "eeprom_record.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/crc16.h>
+#include "eeprom_driver.h"
+
+
+
+
+static uint16_t eeprom_record_copy_addr(eeprom_record_t *rec, uint8_t copy);
+static bool eeprom_record_load_copy(eeprom_record_t *rec, uint8_t copy, uint8_t gen, uint8_t *data);
+static uint16_t eeprom_record_crc(uint8_t version, uint8_t gen, const uint8_t *data, uint8_t size);
+
+
+
+
+void eeprom_record_init(eeprom_record_t *rec, uint16_t ee_addr, uint8_t size, uint8_t version) {
+    rec->ee_addr = ee_addr;
+    rec->size = size;
+    rec->version = version;
+    rec->gen = 0xFF;
+    rec->copy = 1;   // first save goes to copy A
+}
+
+
+// Headers of both copies, then one block read of the newest one. Returns false if there is no valid copy,
+// data is undefined in this case.
+bool eeprom_record_load(eeprom_record_t *rec, void *data) {
+    uint8_t header_a[2], header_b[2];   // version, gen
+    uint8_t first;
+
+
+    eeprom_driver_read(eeprom_record_copy_addr(rec, 0), 2, header_a);
+    eeprom_driver_read(eeprom_record_copy_addr(rec, 1), 2, header_b);
+
+    first = 0;
+    if ((header_b[0] == rec->version) &&
+        ((header_a[0] != rec->version) || ((int8_t)(header_b[1] - header_a[1]) > 0))) {
+        first = 1;
+    }
+
+    if (first == 0) {
+        if ((header_a[0] == rec->version) && eeprom_record_load_copy(rec, 0, header_a[1], data)) return true;
+        if ((header_b[0] == rec->version) && eeprom_record_load_copy(rec, 1, header_b[1], data)) return true;
+    }
+    else {
+        if (eeprom_record_load_copy(rec, 1, header_b[1], data)) return true;
+        if ((header_a[0] == rec->version) && eeprom_record_load_copy(rec, 0, header_a[1], data)) return true;
+    }
+
+    eeprom_record_init(rec, rec->ee_addr, rec->size, rec->version);
+    return false;
+}
+
+
+// Queued, the loaded copy stays intact until the new one is complete
+void eeprom_record_save(eeprom_record_t *rec, const void *data) {
+    uint16_t addr;
+    uint16_t crc;
+
+
+    rec->copy ^= 1;
+    rec->gen++;
+    if (rec->gen == 0xFF) rec->gen = 0;
+    crc = eeprom_record_crc(rec->version, rec->gen, (const uint8_t*)data, rec->size);
+
+    addr = eeprom_record_copy_addr(rec, rec->copy);
+    eeprom_driver_write_8(addr, rec->version);
+    eeprom_driver_write_8((addr + 1), rec->gen);
+    eeprom_driver_write((addr + 2), rec->size, (const uint8_t*)data);
+    eeprom_driver_write_16((addr + 2 + rec->size), crc);
+}
+
+
+
+
+static uint16_t eeprom_record_copy_addr(eeprom_record_t *rec, uint8_t copy) {
+    if (copy == 0) return rec->ee_addr;
+    return rec->ee_addr + EEPROM_RECORD_COPY_SIZE(rec->size);
+}
+
+
+static bool eeprom_record_load_copy(eeprom_record_t *rec, uint8_t copy, uint8_t gen, uint8_t *data) {
+    uint16_t addr;
+    uint16_t crc;
+
+
+    if (gen == 0xFF) return false;   // erased
+
+    addr = eeprom_record_copy_addr(rec, copy);
+    eeprom_driver_read((addr + 2), rec->size, data);
+    eeprom_driver_read_16((addr + 2 + rec->size), &crc);
+    if (crc != eeprom_record_crc(rec->version, gen, data, rec->size)) return false;
+
+    rec->gen = gen;
+    rec->copy = copy;
+    return true;
+}
+
+
+static uint16_t eeprom_record_crc(uint8_t version, uint8_t gen, const uint8_t *data, uint8_t size) {
+    uint16_t crc;
+
+
+    crc = 0xFFFF;
+    crc = _crc_ccitt_update(crc, version);
+    crc = _crc_ccitt_update(crc, gen);
+    while (size > 0) {
+        crc = _crc_ccitt_update(crc, *data);
+        data++;
+        size--;
+    }
+
+    return crc;
+}
@@ -0,0 +1,29 @@
+#ifndef _EEPROM_RECORD_H_
+#define _EEPROM_RECORD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Versioned record with two copies (A, B) in EEPROM. Copy: version, gen, payload, CRC-16 (CCITT, BE - HHLL).
+// A save goes to the older copy with the next gen, a torn write fails the CRC and the other copy is loaded.
+#define EEPROM_RECORD_OVERHEAD          (4)
+#define EEPROM_RECORD_COPY_SIZE(size)   ((size) + EEPROM_RECORD_OVERHEAD)
+#define EEPROM_RECORD_AB_SIZE(size)     (2 * EEPROM_RECORD_COPY_SIZE(size))
+
+
+typedef struct {
+    uint16_t ee_addr;   // copy A, copy B follows
+    uint8_t size;       // payload
+    uint8_t version;    // payload layout, 0xFF is not allowed
+    uint8_t gen;        // of the loaded copy
+    uint8_t copy;       // loaded copy: 0 - A, 1 - B
+} eeprom_record_t;
+
+
+extern void eeprom_record_init(eeprom_record_t *rec, uint16_t ee_addr, uint8_t size, uint8_t version);
+extern bool eeprom_record_load(eeprom_record_t *rec, void *data);
+extern void eeprom_record_save(eeprom_record_t *rec, const void *data);
+
+
+#endif   // _EEPROM_RECORD_H_
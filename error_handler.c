@@ -2,4 +2,4 @@
 #include <stdint.h>
 
 
-uint8_t eh_state = 0;
+uint16_t eh_state = 0;
@@ -8,9 +8,19 @@
 #define EH_STATUS_FLAG_FW_ERR                   (1 << 0)
 #define EH_STATUS_FLAG_LCD_DCDC_OVERVOLTAGE_ERR (1 << 1)
 #define EH_STATUS_FLAG_LCD_DCDC_OVERCURRENT_ERR (1 << 2)
+#define EH_STATUS_FLAG_CAL_ERR                  (1 << 3)
+#define EH_STATUS_FLAG_HEATER_ERR               (1 << 4)   // setpoint not reached in time
+#define EH_STATUS_FLAG_HEATER_RUNAWAY_ERR       (1 << 5)   // heating rate does not match the applied duty
+#define EH_STATUS_FLAG_HEATER_TC_OPEN_ERR       (1 << 6)
+#define EH_STATUS_FLAG_HEATER_TC_SHORT_ERR      (1 << 7)
+#define EH_STATUS_FLAG_FAN_ERR                  (1 << 8)   // no tachometer pulses while driven
+#define EH_STATUS_FLAG_BOARD_OVERTEMP_ERR       (1 << 9)   // MCP9804 above the critical limit
 
+// Stop the heater only, the menu and the LED exposure keep working. The rest is fatal.
+#define EH_STATUS_HEATER_ONLY_MSK               (EH_STATUS_FLAG_CAL_ERR | EH_STATUS_FLAG_FAN_ERR | EH_STATUS_FLAG_BOARD_OVERTEMP_ERR)
 
-extern uint8_t eh_state;
+
+extern uint16_t eh_state;
 
 
 #endif   // ERROR_HANDLING_H
@@ -0,0 +1,207 @@
+#include "fan_driver.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio_driver.h"
+#include "pwm_driver.h"
+#include "pid_controller.h"
+#include "systimer.h"
+#include "eeprom_driver.h"
+#include "device_registers.h"
+#include "error_handler.h"
+#include "heater_driver.h"
+#include "eeprom_log.h"
+
+
+#define FAN_TACH_PIN_STATE   (GPIOB_GET(GPIOB_FAN_TACH_PIN))   // open collector
+#define FAN_TACH_PULL_UP_EN  (GPIOB_SET(GPIOB_FAN_TACH_PIN))
+
+#define FAN_PWM_TOP          ((F_CPU / 25000) - 1)   // 25 kHz, if the fan is the Tim 1 first owner
+#define FAN_PWM_CS           (1)                     // F_CPU / 1
+
+// Tachometer is sampled in the systimer irq (Tim 2 overflow, 256 us)
+#define FAN_TACH_SAMPLE_US   (256)
+#define FAN_TACH_PPR         (2)   // pulses per revolution
+#define FAN_TACH_RPM_K       ((60UL * 1000000UL) / (FAN_TACH_SAMPLE_US * FAN_TACH_PPR))
+#define FAN_TACH_TIMEOUT_MS  (1000)
+
+#define FAN_PID_KP           (4 << PID_CONTROLLER_GAIN_SHIFT)   // duty per rpm
+#define FAN_PID_KI           (8)                                // Q4, duty per rpm per tick
+#define FAN_PID_KAW          (4)
+
+#define FAN_HEATING_MIN_PCT  (30)    // airflow needed by the heater element
+#define FAN_COOLDOWN_C       (60)
+#define FAN_STALL_MIN_PCT    (30)
+#define FAN_STALL_TIME_MS    (2000)
+
+#define FAN_HEATER_ERR_MSK   (EH_STATUS_FLAG_HEATER_ERR | EH_STATUS_FLAG_HEATER_RUNAWAY_ERR | EH_STATUS_FLAG_HEATER_TC_OPEN_ERR | EH_STATUS_FLAG_HEATER_TC_SHORT_ERR | EH_STATUS_FLAG_BOARD_OVERTEMP_ERR)
+
+
+uint8_t fan_setup_pct;
+uint16_t fan_rpm;
+uint16_t fan_max_rpm;
+uint8_t fan_state;
+
+static volatile uint8_t fan_tach_edges;
+static volatile uint16_t fan_tach_time;
+static volatile uint16_t fan_tach_edge_time;
+static uint16_t fan_tach_edge_time_prev;
+static bool is_fan_tach_valid;
+static uint16_t fan_tach_no_edge_ms;
+static uint16_t fan_stall_ms;
+static bool is_fan_pwm;
+static pid_controller_t fan_pid;
+static timer_t fan_control_timer;
+static eeprom_log_t fan_setup_log;
+
+
+
+
+static void fan_driver_tach_calc(void);
+
+
+
+
+void fan_driver_init(void) {
+    uint16_t setup_pct;
+
+
+    FAN_TACH_PULL_UP_EN;
+
+    is_fan_pwm = pwm_driver_alloc(FAN_PWM_CH, FAN_PWM_TOP, FAN_PWM_CS, true);
+
+    eeprom_driver_read_16(EE_ADDR_FAN_MAX_RPM, &fan_max_rpm);
+    if ((fan_max_rpm == 0) || (fan_max_rpm > 0x7FFF)) fan_max_rpm = FAN_MAX_RPM_DEF;
+    eeprom_log_init(&fan_setup_log, EE_PART_LAST_FAN_LOG_ADDR, EE_PART_LAST_FAN_LOG_SIZE);
+    if (!eeprom_log_get(&fan_setup_log, &setup_pct) || (setup_pct > 100)) setup_pct = 0;
+    fan_setup_pct = setup_pct;
+
+    pid_controller_init(&fan_pid, FAN_PID_KP, FAN_PID_KI, 0, FAN_PID_KAW, 0xFFFF);
+
+    fan_rpm = 0;
+    fan_state = FAN_STATE_OFF;
+    is_fan_tach_valid = false;
+    fan_tach_no_edge_ms = 0;
+    fan_stall_ms = 0;
+    fan_control_timer = systimer_set_ms(FAN_CONTROL_PERIOD_MS);
+}
+
+
+void fan_driver_process(void) {
+    uint8_t pct;
+    uint16_t duty;
+    uint16_t feed_forward;
+
+
+    if (fan_setup_pct <= 100) eeprom_log_set(&fan_setup_log, fan_setup_pct);
+    eeprom_log_process(&fan_setup_log);
+
+    if (!systimer_triggered_ms(fan_control_timer)) return;
+    fan_control_timer += FAN_CONTROL_PERIOD_MS;
+    if (!is_fan_pwm) return;
+
+    fan_driver_tach_calc();
+
+    // Heater protection: minimal airflow while heating, full speed until the element is cold.
+    // No cool-down before the first heater sample, the temperature is unknown until then.
+    pct = fan_setup_pct;
+    if (pct > 100) pct = 100;
+    if (heater_is_enabled(&heater[HEATER_MAIN])) {
+        if (pct < FAN_HEATING_MIN_PCT) pct = FAN_HEATING_MIN_PCT;
+        if (fan_state == FAN_STATE_COOLDOWN) fan_state = FAN_STATE_RUN;
+    }
+    else if (((eh_state & FAN_HEATER_ERR_MSK) != 0) ||
+             (heater[HEATER_MAIN].is_real_temperature_valid && (heater[HEATER_MAIN].real_temperature_c > FAN_COOLDOWN_C))) {
+        pct = 100;
+        if (fan_state != FAN_STATE_STALL) fan_state = FAN_STATE_COOLDOWN;
+    }
+    else if (fan_state == FAN_STATE_COOLDOWN) {
+        fan_state = FAN_STATE_OFF;
+    }
+
+    if (pct == 0) {
+        if (fan_state != FAN_STATE_STALL) fan_state = FAN_STATE_OFF;
+        pid_controller_reset(&fan_pid);
+        fan_stall_ms = 0;
+        pwm_driver_connect(FAN_PWM_CH, false);
+        pwm_driver_set_ocr(FAN_PWM_CH, 0);
+        return;
+    }
+    if (fan_state == FAN_STATE_OFF) fan_state = FAN_STATE_RUN;
+
+    // Open loop duty + speed loop
+    feed_forward = (uint16_t)(((uint32_t)0xFFFF * pct) / 100);
+    duty = pid_controller_process(&fan_pid, (int16_t)(((uint32_t)fan_max_rpm * pct) / 100), (int16_t)fan_rpm, feed_forward);
+    if (fan_state == FAN_STATE_STALL) duty = 0xFFFF;
+
+    if ((pct >= FAN_STALL_MIN_PCT) && (fan_rpm == 0)) {
+        if (fan_stall_ms < FAN_STALL_TIME_MS) {
+            fan_stall_ms += FAN_CONTROL_PERIOD_MS;
+        }
+        else {
+            fan_state = FAN_STATE_STALL;
+            eh_state |= EH_STATUS_FLAG_FAN_ERR;
+        }
+    }
+    else {
+        fan_stall_ms = 0;
+    }
+
+    pwm_driver_set_duty(FAN_PWM_CH, duty);
+    pwm_driver_connect(FAN_PWM_CH, true);
+}
+
+
+// Tim 2 overflow irq: tachometer rising edges and the time of the last one
+void fan_driver_tach_process(void) {
+    static uint8_t tach_prev = 0;
+    uint8_t tach;
+
+
+    fan_tach_time++;
+    tach = FAN_TACH_PIN_STATE;
+    if (tach && !tach_prev) {
+        if (fan_tach_edges < 0xFF) fan_tach_edges++;
+        fan_tach_edge_time = fan_tach_time;
+    }
+    tach_prev = tach;
+}
+
+
+
+
+// rpm from the edges of the last control period and the time between the last edges of
+// this and the previous period - resolution is one sample (256 us) per period
+static void fan_driver_tach_calc(void) {
+    uint8_t edges;
+    uint16_t edge_time;
+    uint16_t span;
+
+
+    cli();
+    edges = fan_tach_edges;
+    fan_tach_edges = 0;
+    edge_time = fan_tach_edge_time;
+    sei();
+
+    if (edges == 0) {
+        if (fan_tach_no_edge_ms < FAN_TACH_TIMEOUT_MS) {
+            fan_tach_no_edge_ms += FAN_CONTROL_PERIOD_MS;
+        }
+        else {
+            fan_rpm = 0;
+            is_fan_tach_valid = false;
+        }
+        return;
+    }
+
+    fan_tach_no_edge_ms = 0;
+    span = edge_time - fan_tach_edge_time_prev;
+    fan_tach_edge_time_prev = edge_time;
+    if (is_fan_tach_valid && (span != 0)) {
+        fan_rpm = ((uint32_t)edges * FAN_TACH_RPM_K) / span;
+        if (fan_rpm > 0x7FFF) fan_rpm = 0x7FFF;
+    }
+    is_fan_tach_valid = true;
+}
@@ -0,0 +1,31 @@
+#ifndef _FAN_DRIVER_H_
+#define _FAN_DRIVER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define FAN_CONTROL_PERIOD_MS (250)
+#define FAN_MAX_RPM_DEF       (6000)   // rpm at 100 %, if EEPROM is empty
+
+
+typedef enum {
+    FAN_STATE_OFF = 0,
+    FAN_STATE_RUN,
+    FAN_STATE_COOLDOWN,   // heater is off, element is still hot - full speed
+    FAN_STATE_STALL,
+} fan_state_t;
+
+
+extern uint8_t fan_setup_pct;
+extern uint16_t fan_rpm;
+extern uint16_t fan_max_rpm;
+extern uint8_t fan_state;   // fan_state_t
+
+
+extern void fan_driver_init(void);
+extern void fan_driver_process(void);
+extern void fan_driver_tach_process(void);
+
+
+#endif   // _FAN_DRIVER_H_
@@ -0,0 +1,202 @@
+#include "fl_exposure.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "fl_profile_store.h"
+#include "led_driver.h"
+#include "systimer.h"
+#if (PHOTODIODE_EN != 0)
+#include "photodiode.h"
+#endif
+
+
+uint8_t fl_exposure_state = FL_EXPOSURE_STATE_IDLE;
+uint8_t fl_exposure_segment;
+uint8_t fl_exposure_segments_qty;
+uint32_t fl_exposure_total_ms;
+uint16_t fl_exposure_dose;
+uint16_t fl_exposure_dose_target;
+uint32_t fl_exposure_last_requested_ms;
+uint32_t fl_exposure_last_actual_ms;
+uint16_t fl_exposure_last_dose;
+
+static const fl_profile_t *exposure_profile;
+static uint32_t elapsed_ms;    // up to the last pause
+static uint32_t run_start_ms;
+static uint32_t dose_mams;        // below one dose unit
+static uint32_t dose_last_ms;
+
+// End of the run in the timer irq, the main loop only finishes the state
+static volatile bool is_cutoff_armed;
+static volatile bool is_cutoff_done;
+static volatile uint32_t cutoff_ms;
+static volatile uint32_t cutoff_done_ms;
+
+
+
+
+static void fl_exposure_stop(void);
+static void fl_exposure_dose_integrate(void);
+
+
+
+
+// The program time is kept in ms: elapsed up to the last pause plus the current run from its start
+// timestamp, so neither the main loop latency nor pauses add up. The profile is used until the end
+// or abort, it is not copied.
+// Dose program ends when the integrated measured current reaches the target, so the LED ramp-up
+// and drift do not change the delivered dose. The program time is the level shape only.
+void fl_exposure_load(const fl_profile_t *profile) {
+    fl_segment_t segment;
+    uint8_t i;
+
+
+    fl_exposure_stop();
+
+    exposure_profile = profile;
+    fl_exposure_segments_qty = fl_profile_segments_qty(profile);
+    fl_exposure_total_ms = 0;
+    for (i = 0; fl_profile_get_segment(profile, i, &segment); i++) {
+        fl_exposure_total_ms += ((uint32_t)segment.ramp_s + segment.hold_s) * 1000;
+    }
+    fl_exposure_dose_target = profile->dose_target;
+    if (fl_exposure_dose_target != 0) fl_exposure_total_ms += fl_exposure_total_ms / FL_EXPOSURE_DOSE_OVERRUN_DIV;
+    fl_exposure_segment = 0;
+    fl_exposure_dose = 0;
+    dose_mams = 0;
+    elapsed_ms = 0;
+    fl_exposure_state = FL_EXPOSURE_STATE_PAUSE;
+}
+
+
+void fl_exposure_run(void) {
+    if (fl_exposure_state != FL_EXPOSURE_STATE_PAUSE) return;
+    run_start_ms = systimer_get_ms();
+    dose_last_ms = run_start_ms;
+    is_cutoff_done = false;
+    cutoff_ms = run_start_ms + (fl_exposure_total_ms - elapsed_ms);
+    is_cutoff_armed = true;
+    fl_exposure_state = FL_EXPOSURE_STATE_RUN;
+    fl_exposure_process();
+}
+
+
+// Remaining time is kept to the ms
+void fl_exposure_pause(void) {
+    if (fl_exposure_state != FL_EXPOSURE_STATE_RUN) return;
+    is_cutoff_armed = false;
+    fl_exposure_dose_integrate();
+    elapsed_ms = fl_exposure_get_elapsed_ms();
+    fl_exposure_stop();
+    fl_exposure_state = FL_EXPOSURE_STATE_PAUSE;
+}
+
+
+void fl_exposure_abort(void) {
+    fl_exposure_stop();
+    fl_exposure_state = FL_EXPOSURE_STATE_IDLE;
+}
+
+
+// Called every main loop: level of the current segment and the pulse gate
+void fl_exposure_process(void) {
+    fl_segment_t segment;
+    uint32_t now_ms, segment_start_ms, t_ms, ramp_ms;
+    uint16_t level_prev;
+    uint8_t i;
+
+
+    if (fl_exposure_state != FL_EXPOSURE_STATE_RUN) return;
+
+    if (!is_cutoff_done) fl_exposure_dose_integrate();
+    now_ms = fl_exposure_get_elapsed_ms();
+    if (!is_cutoff_done && ((now_ms >= fl_exposure_total_ms) || ((fl_exposure_dose_target != 0) && (fl_exposure_dose >= fl_exposure_dose_target)))) {
+        // Dose reached or the irq missed the end (armed late)
+        is_cutoff_armed = false;
+        led_driver_cutoff();
+        cutoff_done_ms = systimer_get_ms();
+        is_cutoff_done = true;
+    }
+    if (is_cutoff_done) {
+        fl_exposure_last_requested_ms = fl_exposure_total_ms;
+        fl_exposure_last_actual_ms = elapsed_ms + (cutoff_done_ms - run_start_ms);
+        fl_exposure_last_dose = fl_exposure_dose;
+        elapsed_ms = fl_exposure_last_actual_ms;
+        fl_exposure_stop();
+        fl_exposure_state = FL_EXPOSURE_STATE_DONE;
+        return;
+    }
+
+    segment_start_ms = 0;
+    level_prev = 0;
+    for (i = 0; fl_profile_get_segment(exposure_profile, i, &segment); i++) {
+        t_ms = ((uint32_t)segment.ramp_s + segment.hold_s) * 1000;
+        if ((now_ms < (segment_start_ms + t_ms)) || ((i + 1) == fl_exposure_segments_qty)) break;   // the last one is held by a dose program
+        segment_start_ms += t_ms;
+        level_prev = segment.current_pct;
+    }
+    fl_exposure_segment = i;
+
+    t_ms = now_ms - segment_start_ms;
+    ramp_ms = (uint32_t)segment.ramp_s * 1000;
+    if (t_ms < ramp_ms) {
+        // Linear ramp, 8 ms steps keep the product in 32 bit
+        led_current_pct = level_prev + (((int32_t)segment.current_pct - level_prev) * (int32_t)(t_ms / 8)) / (int32_t)(ramp_ms / 8);
+    }
+    else {
+        led_current_pct = segment.current_pct;
+    }
+
+    if (segment.pulse_on_ms == 0) led_driver_set_gate(true);
+    else led_driver_set_gate((t_ms % ((uint32_t)segment.pulse_on_ms + segment.pulse_off_ms)) < segment.pulse_on_ms);
+}
+
+
+uint32_t fl_exposure_get_elapsed_ms(void) {
+    uint32_t ms;
+
+
+    if (fl_exposure_state != FL_EXPOSURE_STATE_RUN) return elapsed_ms;
+    ms = elapsed_ms + (systimer_get_ms() - run_start_ms);
+    if (ms > fl_exposure_total_ms) ms = fl_exposure_total_ms;
+    return ms;
+}
+
+
+// Tim 2 overflow irq, after systimer_process_ms(): the LED is off in the ms of the end
+void fl_exposure_cutoff_process(void) {
+    if (!is_cutoff_armed || (systimer_get_ms() < cutoff_ms)) return;
+    is_cutoff_armed = false;
+    led_driver_cutoff();
+    cutoff_done_ms = systimer_get_ms();
+    is_cutoff_done = true;
+}
+
+
+
+
+// Measured current or irradiance (updated once per ADC sweep) times the time from the previous call
+static void fl_exposure_dose_integrate(void) {
+    uint32_t now_ms;
+    uint16_t rate;
+
+
+    rate = led_current_ma;
+    #if (PHOTODIODE_EN != 0)
+    if (photodiode_is_calibr) rate = photodiode_irradiance;
+    #endif
+    now_ms = systimer_get_ms();
+    dose_mams += (uint32_t)rate * (now_ms - dose_last_ms);
+    dose_last_ms = now_ms;
+    while (dose_mams >= FL_PROFILE_DOSE_UNIT_MAMS) {
+        dose_mams -= FL_PROFILE_DOSE_UNIT_MAMS;
+        if (fl_exposure_dose < 0xFFFF) fl_exposure_dose++;
+    }
+}
+
+
+static void fl_exposure_stop(void) {
+    is_cutoff_armed = false;
+    led_current_pct = 0;
+    led_driver_cutoff();
+    led_driver_set_gate(true);
+}
@@ -0,0 +1,40 @@
+#ifndef _FL_EXPOSURE_H_
+#define _FL_EXPOSURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fl_profile_store.h"
+
+
+#define FL_EXPOSURE_DOSE_OVERRUN_DIV (2)   // dose program: the last segment is held up to +1/2 of the program time
+
+
+typedef enum {
+    FL_EXPOSURE_STATE_IDLE = 0,
+    FL_EXPOSURE_STATE_PAUSE,   // loaded or paused, elapsed time is kept
+    FL_EXPOSURE_STATE_RUN,
+    FL_EXPOSURE_STATE_DONE,
+} fl_exposure_state_t;
+
+
+extern uint8_t fl_exposure_state;   // fl_exposure_state_t
+extern uint8_t fl_exposure_segment;
+extern uint8_t fl_exposure_segments_qty;
+extern uint32_t fl_exposure_total_ms;
+extern uint16_t fl_exposure_dose;          // 0.1 A*s
+extern uint16_t fl_exposure_dose_target;   // 0 - time program
+extern uint32_t fl_exposure_last_requested_ms;   // last finished program
+extern uint32_t fl_exposure_last_actual_ms;
+extern uint16_t fl_exposure_last_dose;
+
+
+extern void fl_exposure_load(const fl_profile_t *profile);
+extern void fl_exposure_run(void);
+extern void fl_exposure_pause(void);
+extern void fl_exposure_abort(void);
+extern void fl_exposure_process(void);
+extern uint32_t fl_exposure_get_elapsed_ms(void);
+extern void fl_exposure_cutoff_process(void);
+
+
+#endif   // _FL_EXPOSURE_H_
@@ -0,0 +1,323 @@
+#include "fl_profile_store.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <util/crc16.h>
+#include "eeprom_driver.h"
+#include "eeprom_record.h"
+#include "eeprom_partitions.h"
+
+
+#define FL_PROFILE_STORE_DIR_VERSION  (1)
+#define FL_PROFILE_STORE_DIR_SIZE     (1 + (2 * FL_PROFILE_STORE_QTY_MAX))   // fl_profile_store_dir_t
+#define FL_PROFILE_STORE_HEAP_ADDR    (EE_PART_FL_PROFILES_ADDR + EEPROM_RECORD_AB_SIZE(FL_PROFILE_STORE_DIR_SIZE))
+#define FL_PROFILE_STORE_CHUNKS_QTY   ((EE_PART_FL_PROFILES_SIZE - EEPROM_RECORD_AB_SIZE(FL_PROFILE_STORE_DIR_SIZE)) / FL_PROFILE_STORE_CHUNK_SIZE)
+#define FL_PROFILE_STORE_ENTRY_HEADER (3)   // CRC, length
+#define FL_PROFILE_HEAD_SIZE          (offsetof(fl_profile_t, segments_qty))   // entry of a constant profile
+#if (FL_PROFILE_STORE_CHUNKS_QTY > 0xFF)
+#error "fl_profile_store: chunk index is 8 bit, increase FL_PROFILE_STORE_CHUNK_SIZE"
+#endif
+#if ((FL_PROFILE_STORE_HEAP_ADDR + (FL_PROFILE_STORE_CHUNKS_QTY * FL_PROFILE_STORE_CHUNK_SIZE)) > EE_SIZE)
+#error "fl_profile_store: heap does not fit EE_SIZE"
+#endif
+
+// Fixed table of the firmware before the store: name, current_pct, time_s (BE - HHLL) in EE_PART_FL_LEGACY
+#define FL_PROFILE_LEGACY_QTY         (8)
+#define FL_PROFILE_LEGACY_SIZE        (FL_PROFILE_NAME_SIZE + 4)
+#define FL_PROFILE_LEGACY_CHUNKS_QTY  ((FL_PROFILE_STORE_ENTRY_HEADER + FL_PROFILE_HEAD_SIZE + FL_PROFILE_STORE_CHUNK_SIZE - 1) / FL_PROFILE_STORE_CHUNK_SIZE)
+#if ((FL_PROFILE_LEGACY_QTY * FL_PROFILE_LEGACY_SIZE) > EE_PART_FL_LEGACY_SIZE)
+#error "fl_profile_store: legacy table does not fit EE_PART_FL_LEGACY"
+#endif
+
+
+typedef struct {
+    uint8_t qty;
+    uint8_t chunk[FL_PROFILE_STORE_QTY_MAX];        // first chunk of the entry
+    uint8_t chunks_qty[FL_PROFILE_STORE_QTY_MAX];
+} fl_profile_store_dir_t;
+
+
+uint8_t fl_profile_store_lost_qty;   // valid legacy profiles the migration could not store
+
+static fl_profile_store_dir_t dir;
+static eeprom_record_t dir_rec;
+
+// The whole legacy table always fits the store
+_Static_assert(FL_PROFILE_STORE_QTY_MAX >= FL_PROFILE_LEGACY_QTY, "fl_profile_store: directory is smaller than the legacy table");
+_Static_assert(FL_PROFILE_STORE_CHUNKS_QTY >= (FL_PROFILE_LEGACY_QTY * FL_PROFILE_LEGACY_CHUNKS_QTY), "fl_profile_store: heap is smaller than the legacy table");
+
+
+
+
+static bool fl_profile_store_is_dir_valid(void);
+static void fl_profile_store_migrate(void);
+static bool fl_profile_store_alloc(uint8_t chunks_qty, uint8_t *chunk);
+static bool fl_profile_store_write_entry(const fl_profile_t *profile, uint8_t len, uint8_t *chunk, uint8_t *chunks_qty);
+static uint8_t fl_profile_store_len(const fl_profile_t *profile);
+static uint16_t fl_profile_store_entry_addr(uint8_t chunk);
+static uint16_t fl_profile_store_crc(uint8_t len, const uint8_t *data);
+
+
+
+
+void fl_profile_store_init(void) {
+    eeprom_record_init(&dir_rec, EE_PART_FL_PROFILES_ADDR, FL_PROFILE_STORE_DIR_SIZE, FL_PROFILE_STORE_DIR_VERSION);
+    if (eeprom_record_load(&dir_rec, &dir) && fl_profile_store_is_dir_valid()) return;
+
+    dir.qty = 0;
+    fl_profile_store_migrate();
+}
+
+
+uint8_t fl_profile_store_qty(void) {
+    return dir.qty;
+}
+
+
+// One block read and the entry CRC, called when the menu shows the profile
+bool fl_profile_store_read(uint8_t idx, fl_profile_t *profile) {
+    uint16_t addr;
+    uint16_t crc;
+    uint8_t len;
+
+
+    if (idx >= dir.qty) return false;
+
+    addr = fl_profile_store_entry_addr(dir.chunk[idx]);
+    eeprom_driver_read_16(addr, &crc);
+    eeprom_driver_read_8((addr + 2), &len);
+    if ((len < FL_PROFILE_HEAD_SIZE) || (len > sizeof(fl_profile_t))) return false;
+    eeprom_driver_read((addr + FL_PROFILE_STORE_ENTRY_HEADER), len, (uint8_t*)profile);
+    if (crc != fl_profile_store_crc(len, (const uint8_t*)profile)) return false;
+
+    if (len == FL_PROFILE_HEAD_SIZE) {
+        profile->segments_qty = 0;
+        profile->dose_target = 0;
+    }
+    return ((profile->segments_qty <= FL_PROFILE_SEGMENTS_MAX) && (len == fl_profile_store_len(profile)));
+}
+
+
+// Appended to the end of the list
+bool fl_profile_store_add(const fl_profile_t *profile) {
+    if ((dir.qty >= FL_PROFILE_STORE_QTY_MAX) || !fl_profile_is_valid(profile)) return false;
+    if (!fl_profile_store_write_entry(profile, fl_profile_store_len(profile), &dir.chunk[dir.qty], &dir.chunks_qty[dir.qty])) return false;
+
+    dir.qty++;
+    eeprom_record_save(&dir_rec, &dir);
+    return true;
+}
+
+
+// New entry in free chunks, the old one is released by the directory commit
+bool fl_profile_store_replace(uint8_t idx, const fl_profile_t *profile) {
+    uint8_t chunk, chunks_qty;
+
+
+    if ((idx >= dir.qty) || !fl_profile_is_valid(profile)) return false;
+    if (!fl_profile_store_write_entry(profile, fl_profile_store_len(profile), &chunk, &chunks_qty)) return false;
+
+    dir.chunk[idx] = chunk;
+    dir.chunks_qty[idx] = chunks_qty;
+    eeprom_record_save(&dir_rec, &dir);
+    return true;
+}
+
+
+bool fl_profile_store_delete(uint8_t idx) {
+    if (idx >= dir.qty) return false;
+
+    dir.qty--;
+    for (; idx < dir.qty; idx++) {
+        dir.chunk[idx] = dir.chunk[idx + 1];
+        dir.chunks_qty[idx] = dir.chunks_qty[idx + 1];
+    }
+    eeprom_record_save(&dir_rec, &dir);
+    return true;
+}
+
+
+// Directory only, the entries are not moved
+bool fl_profile_store_move(uint8_t idx, uint8_t new_idx) {
+    uint8_t chunk, chunks_qty;
+
+
+    if ((idx >= dir.qty) || (new_idx >= dir.qty)) return false;
+
+    chunk = dir.chunk[idx];
+    chunks_qty = dir.chunks_qty[idx];
+    for (; idx < new_idx; idx++) {
+        dir.chunk[idx] = dir.chunk[idx + 1];
+        dir.chunks_qty[idx] = dir.chunks_qty[idx + 1];
+    }
+    for (; idx > new_idx; idx--) {
+        dir.chunk[idx] = dir.chunk[idx - 1];
+        dir.chunks_qty[idx] = dir.chunks_qty[idx - 1];
+    }
+    dir.chunk[new_idx] = chunk;
+    dir.chunks_qty[new_idx] = chunks_qty;
+    eeprom_record_save(&dir_rec, &dir);
+    return true;
+}
+
+
+bool fl_profile_is_valid(const fl_profile_t *profile) {
+    fl_segment_t segment;
+    uint32_t time_s;
+    uint8_t i;
+
+
+    if (profile->segments_qty > FL_PROFILE_SEGMENTS_MAX) return false;
+    time_s = 0;
+    for (i = 0; fl_profile_get_segment(profile, i, &segment); i++) {
+        if (segment.current_pct > 100) return false;
+        time_s += (uint32_t)segment.ramp_s + segment.hold_s;
+    }
+    if (time_s < 1) return false;
+
+    for (i = 0; i < FL_PROFILE_NAME_SIZE; i++) {
+        if ((profile->name[i] != ' ') && (profile->name[i] != 0xFF)) return true;
+    }
+    return false;   // empty name
+}
+
+
+// Constant profile is one segment without a ramp
+bool fl_profile_get_segment(const fl_profile_t *profile, uint8_t idx, fl_segment_t *segment) {
+    if (idx >= fl_profile_segments_qty(profile)) return false;
+
+    if (profile->segments_qty == 0) {
+        segment->current_pct = profile->current_pct;
+        segment->ramp_s = 0;
+        segment->hold_s = profile->time_s;
+        segment->pulse_on_ms = 0;
+        segment->pulse_off_ms = 0;
+    }
+    else {
+        *segment = profile->segments[idx];
+    }
+    return true;
+}
+
+
+uint8_t fl_profile_segments_qty(const fl_profile_t *profile) {
+    if (profile->segments_qty == 0) return 1;
+    return profile->segments_qty;
+}
+
+
+
+
+static bool fl_profile_store_is_dir_valid(void) {
+    uint8_t i;
+
+
+    if (dir.qty > FL_PROFILE_STORE_QTY_MAX) return false;
+    for (i = 0; i < dir.qty; i++) {
+        if ((dir.chunks_qty[i] == 0) || (((uint16_t)dir.chunk[i] + dir.chunks_qty[i]) > FL_PROFILE_STORE_CHUNKS_QTY)) return false;
+    }
+    return true;
+}
+
+
+// No directory: valid slots of the legacy table are copied as entries, in order. The table has its own
+// partition and is only read, an interrupted migration is run again from the intact table on the next boot.
+static void fl_profile_store_migrate(void) {
+    fl_profile_t profile;
+    uint8_t i;
+    uint16_t addr;
+
+
+    addr = EE_PART_FL_LEGACY_ADDR;
+    profile.segments_qty = 0;
+    profile.dose_target = 0;
+    for (i = 0; i < FL_PROFILE_LEGACY_QTY; i++) {
+        eeprom_driver_read(addr, FL_PROFILE_NAME_SIZE, profile.name);
+        eeprom_driver_read_16((addr + FL_PROFILE_NAME_SIZE), &profile.current_pct);
+        eeprom_driver_read_16((addr + FL_PROFILE_NAME_SIZE + 2), &profile.time_s);
+        if (fl_profile_is_valid(&profile)) {
+            if ((dir.qty < FL_PROFILE_STORE_QTY_MAX) &&
+                fl_profile_store_write_entry(&profile, FL_PROFILE_HEAD_SIZE, &dir.chunk[dir.qty], &dir.chunks_qty[dir.qty])) {
+                dir.qty++;
+            }
+            else {
+                fl_profile_store_lost_qty++;
+            }
+        }
+        addr += FL_PROFILE_LEGACY_SIZE;
+    }
+    if (dir.qty > 0) eeprom_record_save(&dir_rec, &dir);
+}
+
+
+// First fit over the chunks not referenced by the directory
+static bool fl_profile_store_alloc(uint8_t chunks_qty, uint8_t *chunk) {
+    uint8_t used[(FL_PROFILE_STORE_CHUNKS_QTY + 7) / 8];
+    uint8_t i, c, run;
+
+
+    for (i = 0; i < sizeof(used); i++) used[i] = 0;
+    for (i = 0; i < dir.qty; i++) {
+        for (c = dir.chunk[i]; c < (dir.chunk[i] + dir.chunks_qty[i]); c++) used[c >> 3] |= (1 << (c & 7));
+    }
+
+    run = 0;
+    for (c = 0; c < FL_PROFILE_STORE_CHUNKS_QTY; c++) {
+        if (used[c >> 3] & (1 << (c & 7))) {
+            run = 0;
+            continue;
+        }
+        run++;
+        if (run == chunks_qty) {
+            *chunk = c + 1 - chunks_qty;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// len - head of the profile, see fl_profile_store_len()
+static bool fl_profile_store_write_entry(const fl_profile_t *profile, uint8_t len, uint8_t *chunk, uint8_t *chunks_qty) {
+    uint16_t addr;
+
+
+    *chunks_qty = (FL_PROFILE_STORE_ENTRY_HEADER + len + FL_PROFILE_STORE_CHUNK_SIZE - 1) / FL_PROFILE_STORE_CHUNK_SIZE;
+    if (!fl_profile_store_alloc(*chunks_qty, chunk)) return false;
+
+    addr = fl_profile_store_entry_addr(*chunk);
+    if ((addr + FL_PROFILE_STORE_ENTRY_HEADER + len) > EE_PART_END(EE_PART_FL_PROFILES)) return false;   // EEAR wraps, never past the partition
+    eeprom_driver_write_16(addr, fl_profile_store_crc(len, (const uint8_t*)profile));
+    eeprom_driver_write_8((addr + 2), len);
+    eeprom_driver_write((addr + FL_PROFILE_STORE_ENTRY_HEADER), len, (const uint8_t*)profile);
+    return true;
+}
+
+
+// Constant profile - name, current_pct, time_s only. Otherwise up to the last used segment.
+static uint8_t fl_profile_store_len(const fl_profile_t *profile) {
+    if ((profile->segments_qty == 0) && (profile->dose_target == 0)) return FL_PROFILE_HEAD_SIZE;
+    return offsetof(fl_profile_t, segments) + (profile->segments_qty * sizeof(fl_segment_t));
+}
+
+
+static uint16_t fl_profile_store_entry_addr(uint8_t chunk) {
+    return FL_PROFILE_STORE_HEAP_ADDR + ((uint16_t)chunk * FL_PROFILE_STORE_CHUNK_SIZE);
+}
+
+
+// Length is covered too, a torn header never passes
+static uint16_t fl_profile_store_crc(uint8_t len, const uint8_t *data) {
+    uint16_t crc;
+
+
+    crc = _crc_ccitt_update(0xFFFF, len);
+    while (len > 0) {
+        crc = _crc_ccitt_update(crc, *data);
+        data++;
+        len--;
+    }
+
+    return crc;
+}
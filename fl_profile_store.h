@@ -0,0 +1,61 @@
+#ifndef _FL_PROFILE_STORE_H_
+#define _FL_PROFILE_STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Profiles are entries in a heap of EE_PART_FL_PROFILES chunks, the order is kept by a directory
+// record. Entry: CRC-16 (BE - HHLL), length, fl_profile_t up to the last used segment. Changes write
+// free chunks first and commit with the directory record, an interrupted change leaves the previous table.
+#if (HEATER_EN != 0)
+#define FL_PROFILE_STORE_QTY_MAX    (8)   // smaller directory record, the heater takes most of the EEPROM
+#else
+#define FL_PROFILE_STORE_QTY_MAX    (16)
+#endif
+#define FL_PROFILE_STORE_CHUNK_SIZE (8)
+#define FL_PROFILE_NAME_SIZE        (14)
+#define FL_PROFILE_SEGMENTS_MAX     (4)
+
+
+// Dose: 0.1 A*s of measured LED current (100 mA for 1 s). With a calibrated photodiode (PHOTODIODE_EN)
+// 0.1 mJ/cm2 of measured light (100 uW/cm2 for 1 s), the same count of uW/cm2*ms.
+#define FL_PROFILE_DOSE_UNIT_MAMS   (100000UL)   // mA*ms, uW/cm2*ms
+
+
+// Ramp from the previous level (0 for the first segment) to current_pct, then hold it.
+// Pulse mode gates the output for the whole segment: pulse_on_ms on, pulse_off_ms off.
+typedef struct {
+    uint16_t current_pct;
+    uint16_t ramp_s;         // 0 - step
+    uint16_t hold_s;
+    uint16_t pulse_on_ms;    // 0 - continuous
+    uint16_t pulse_off_ms;
+} fl_segment_t;
+
+typedef struct {
+    uint8_t name[FL_PROFILE_NAME_SIZE];   // not terminated, space padded
+    uint16_t current_pct;                 // segments_qty = 0: constant current_pct for time_s
+    uint16_t time_s;
+    uint16_t segments_qty;
+    uint16_t dose_target;                 // 0.1 A*s, 0 - the program ends by time
+    fl_segment_t segments[FL_PROFILE_SEGMENTS_MAX];
+} fl_profile_t;
+
+
+extern uint8_t fl_profile_store_lost_qty;
+
+
+extern void fl_profile_store_init(void);
+extern uint8_t fl_profile_store_qty(void);
+extern bool fl_profile_store_read(uint8_t idx, fl_profile_t *profile);
+extern bool fl_profile_store_add(const fl_profile_t *profile);
+extern bool fl_profile_store_replace(uint8_t idx, const fl_profile_t *profile);
+extern bool fl_profile_store_delete(uint8_t idx);
+extern bool fl_profile_store_move(uint8_t idx, uint8_t new_idx);
+extern bool fl_profile_is_valid(const fl_profile_t *profile);
+extern bool fl_profile_get_segment(const fl_profile_t *profile, uint8_t idx, fl_segment_t *segment);
+extern uint8_t fl_profile_segments_qty(const fl_profile_t *profile);
+
+
+#endif   // _FL_PROFILE_STORE_H_
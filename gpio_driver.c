@@ -5,12 +5,21 @@
 #define GPIO_INPUT  (0)
 #define GPIO_OUTPUT (1)
 
+// Port B pins that differ per board, see gpio_driver.h
+#if (HEATER_EN != 0)
+#define GPIO_PB7_MODE (GPIO_OUTPUT)   // LED_EN
+#define GPIO_PB5_MODE (GPIO_OUTPUT)   // status LED
+#else
+#define GPIO_PB7_MODE (GPIO_INPUT)
+#define GPIO_PB5_MODE (GPIO_INPUT)
+#endif
+
 
 void gpio_init(void) {
     // Port B initialization
-    DDRB = (GPIO_INPUT  << DDB7) |
+    DDRB = (GPIO_PB7_MODE << DDB7) |
            (GPIO_INPUT  << DDB6) |
-           (GPIO_INPUT  << DDB5) |
+           (GPIO_PB5_MODE << DDB5) |
            (GPIO_INPUT  << DDB4) |
            (GPIO_OUTPUT << DDB3) |
            (GPIO_OUTPUT << DDB2) |
@@ -32,6 +32,24 @@
 #define GPIOD_MODE_OUTPUT(pin_n) DDRD |= (1 << pin_n)
 #define GPIOD_MODE_INPUT(pin_n) DDRD &= ~(1 << pin_n)
 
+// Port B pins used as plain GPIO, PB1..PB3 are the PWM compare outputs (checked in pwm_driver.h)
+#if (HEATER_EN != 0)
+// Heater board: OC2/PB3 drives the heater, OC1B/PB2 the fan. It runs on the internal 8 MHz RC
+// oscillator (CKSEL fuses), PB6 and PB7 are not XTAL1/XTAL2 there.
+#define GPIOB_TAMPER_PIN        (0)
+#define GPIOB_HEATER_STAND_PIN  (4)
+#define GPIOB_STATUS_LED_PIN    (5)   // SCK, shared with the ISP header
+#define GPIOB_FAN_TACH_PIN      (6)
+#define GPIOB_LED_EN_PIN        (7)
+#define GPIOB_USED_MSK ((1 << GPIOB_TAMPER_PIN) | (1 << GPIOB_LED_EN_PIN) | (1 << GPIOB_STATUS_LED_PIN) | \
+                        (1 << GPIOB_HEATER_STAND_PIN) | (1 << GPIOB_FAN_TACH_PIN))
+#else
+#define GPIOB_TAMPER_PIN        (0)
+#define GPIOB_LED_EN_PIN        (2)
+#define GPIOB_STATUS_LED_PIN    (3)
+#define GPIOB_USED_MSK ((1 << GPIOB_TAMPER_PIN) | (1 << GPIOB_LED_EN_PIN) | (1 << GPIOB_STATUS_LED_PIN))
+#endif
+
 
 extern void gpio_init(void);
 
@@ -0,0 +1,157 @@
+#include "heater_autotune.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "heater_driver.h"
+#include "pid_controller.h"
+#include "eeprom_driver.h"
+#include "device_registers.h"
+#include "systimer.h"
+
+
+// Relay feedback (Astrom-Hagglund): heater is switched full on / off around the setpoint,
+// ultimate gain and period are taken from the forced oscillation, gains by Ziegler-Nichols.
+#define HEATER_AUTOTUNE_HYST_C            (1)
+#define HEATER_AUTOTUNE_MAX_OVERSHOOT_C   (40)
+#define HEATER_AUTOTUNE_TIMEOUT_MS        (15UL * 60 * 1000)
+#define HEATER_AUTOTUNE_SKIP_CYCLES       (2)
+#define HEATER_AUTOTUNE_MEAS_CYCLES       (3)
+#define HEATER_AUTOTUNE_RELAY_D           (HEATER_OCR_MAX / 2)   // relay half amplitude
+#define HEATER_AUTOTUNE_MIN_PERIOD_MS     (4 * HEATER_CONTROL_PERIOD_MS)
+
+
+uint8_t heater_autotune_state = HEATER_AUTOTUNE_STATE_IDLE;
+uint16_t heater_autotune_setpoint_c = 250;
+
+static timer_t heater_autotune_timer;
+static bool is_relay_on;
+static uint8_t cycle_cnt;
+static uint32_t cycle_start_ms;
+static uint16_t cycle_max_c, cycle_min_c;
+static uint32_t period_sum_ms;
+static uint16_t peak_to_peak_sum_c;
+
+
+
+
+static void heater_autotune_calc_gains(void);
+
+
+
+
+void heater_autotune_start(void) {
+    if (heater_autotune_setpoint_c > (HEATER_MAX_SETUP_TEMP_C - HEATER_AUTOTUNE_MAX_OVERSHOOT_C)) {
+        heater_autotune_state = HEATER_AUTOTUNE_STATE_ERR_OVERTEMP;
+        return;
+    }
+
+    heater_autotune_timer = systimer_set_ms(HEATER_AUTOTUNE_TIMEOUT_MS);
+    is_relay_on = true;
+    cycle_cnt = 0;
+    cycle_max_c = 0;
+    cycle_min_c = 0xFFFF;
+    period_sum_ms = 0;
+    peak_to_peak_sum_c = 0;
+    heater_autotune_state = HEATER_AUTOTUNE_STATE_RUN;
+}
+
+
+void heater_autotune_abort(void) {
+    if (heater_autotune_state == HEATER_AUTOTUNE_STATE_RUN) heater_autotune_state = HEATER_AUTOTUNE_STATE_ABORTED;
+}
+
+
+bool heater_autotune_is_running(void) {
+    return (heater_autotune_state == HEATER_AUTOTUNE_STATE_RUN);
+}
+
+
+// Called from the heater control tick, returns heater OCR
+uint16_t heater_autotune_process(uint16_t real_temperature_c) {
+    uint32_t time_ms;
+
+
+    if (heater_autotune_state != HEATER_AUTOTUNE_STATE_RUN) return 0;
+
+    if (systimer_triggered_ms(heater_autotune_timer)) {
+        heater_autotune_state = HEATER_AUTOTUNE_STATE_ERR_TIMEOUT;
+        return 0;
+    }
+    if (real_temperature_c > (heater_autotune_setpoint_c + HEATER_AUTOTUNE_MAX_OVERSHOOT_C)) {
+        heater_autotune_state = HEATER_AUTOTUNE_STATE_ERR_OVERTEMP;
+        return 0;
+    }
+
+    if (real_temperature_c > cycle_max_c) cycle_max_c = real_temperature_c;
+    if (real_temperature_c < cycle_min_c) cycle_min_c = real_temperature_c;
+
+    if (is_relay_on) {
+        if (real_temperature_c >= (heater_autotune_setpoint_c + HEATER_AUTOTUNE_HYST_C)) {
+            is_relay_on = false;
+
+            // One cycle = between two on->off switches, it holds exactly one peak and one trough
+            time_ms = systimer_get_ms();
+            if (cycle_cnt > HEATER_AUTOTUNE_SKIP_CYCLES) {
+                period_sum_ms += time_ms - cycle_start_ms;
+                peak_to_peak_sum_c += cycle_max_c - cycle_min_c;
+            }
+            cycle_start_ms = time_ms;
+            cycle_max_c = 0;
+            cycle_min_c = 0xFFFF;
+            cycle_cnt++;
+
+            if (cycle_cnt > (HEATER_AUTOTUNE_SKIP_CYCLES + HEATER_AUTOTUNE_MEAS_CYCLES)) {
+                heater_autotune_calc_gains();
+                return 0;
+            }
+        }
+    }
+    else {
+        if ((real_temperature_c + HEATER_AUTOTUNE_HYST_C) <= heater_autotune_setpoint_c) is_relay_on = true;
+    }
+
+    if (is_relay_on) return HEATER_OCR_MAX;
+    return 0;
+}
+
+
+
+
+static void heater_autotune_calc_gains(void) {
+    uint32_t period_ms;
+    uint16_t peak_to_peak_c;
+    uint32_t ku, kp, ki, kd;
+
+
+    period_ms = period_sum_ms / HEATER_AUTOTUNE_MEAS_CYCLES;
+    peak_to_peak_c = peak_to_peak_sum_c / HEATER_AUTOTUNE_MEAS_CYCLES;
+    if (peak_to_peak_c == 0) peak_to_peak_c = 1;
+
+    if (period_ms < HEATER_AUTOTUNE_MIN_PERIOD_MS) {
+        heater_autotune_state = HEATER_AUTOTUNE_STATE_ERR_RESULT;
+        return;
+    }
+
+    // Ku = 4 * d / (pi * a), a = peak_to_peak / 2   (Q4)
+    ku = ((uint32_t)HEATER_AUTOTUNE_RELAY_D * (8 * 100 << PID_CONTROLLER_GAIN_SHIFT)) / (314UL * peak_to_peak_c);
+    // Kp = 0.6 * Ku, Ti = Pu / 2, Td = Pu / 8
+    kp = (ku * 6) / 10;
+    // A gain out of the 16 bit range (peak to peak of a few C) is not usable, the stored gains are kept
+    if ((kp == 0) || (kp > 0xFFFF) || (period_ms > (0xFFFFFFFFUL / kp))) {
+        heater_autotune_state = HEATER_AUTOTUNE_STATE_ERR_RESULT;
+        return;
+    }
+    ki = (kp * 2 * HEATER_CONTROL_PERIOD_MS) / period_ms;
+    kd = (kp * period_ms) / (8 * HEATER_CONTROL_PERIOD_MS);   // Q4 as kp
+    if ((ki > 0xFFFF) || (kd > 0xFFFF)) {
+        heater_autotune_state = HEATER_AUTOTUNE_STATE_ERR_RESULT;
+        return;
+    }
+
+    heater[HEATER_MAIN].pid.kp = (uint16_t)kp;
+    heater[HEATER_MAIN].pid.ki = (uint16_t)ki;
+    heater[HEATER_MAIN].pid.kd = (uint16_t)kd;
+    pid_controller_reset(&heater[HEATER_MAIN].pid);
+    heater_params_save(&heater[HEATER_MAIN]);
+
+    heater_autotune_state = HEATER_AUTOTUNE_STATE_DONE;
+}
@@ -0,0 +1,29 @@
+#ifndef _HEATER_AUTOTUNE_H_
+#define _HEATER_AUTOTUNE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+typedef enum {
+    HEATER_AUTOTUNE_STATE_IDLE = 0,
+    HEATER_AUTOTUNE_STATE_RUN,
+    HEATER_AUTOTUNE_STATE_DONE,
+    HEATER_AUTOTUNE_STATE_ERR_TIMEOUT,
+    HEATER_AUTOTUNE_STATE_ERR_OVERTEMP,
+    HEATER_AUTOTUNE_STATE_ERR_RESULT,
+    HEATER_AUTOTUNE_STATE_ABORTED,
+} heater_autotune_state_t;
+
+
+extern uint8_t heater_autotune_state;   // heater_autotune_state_t
+extern uint16_t heater_autotune_setpoint_c;
+
+
+extern void heater_autotune_start(void);
+extern void heater_autotune_abort(void);
+extern bool heater_autotune_is_running(void);
+extern uint16_t heater_autotune_process(uint16_t real_temperature_c);
+
+
+#endif   // _HEATER_AUTOTUNE_H_
@@ -0,0 +1,237 @@
+#include "heater_calibr.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "heater_driver.h"
+#if (HEATER_AUTOTUNE_EN != 0)
+#include "heater_autotune.h"
+#endif
+#if (HEATER_PROFILE_EN != 0)
+#include "heater_profile.h"
+#endif
+#include "tc_type_k.h"
+#include "calibr.h"
+#include "meas.h"
+#include "device_registers.h"
+#include "systimer.h"
+
+
+// Stability: window mean and variance of the raw signal, one sample per heater control tick
+#define HEATER_CALIBR_WINDOW             (32)
+#define HEATER_CALIBR_MAX_VAR_N2         (2UL * HEATER_CALIBR_WINDOW * HEATER_CALIBR_WINDOW)   // 2 codes^2
+#define HEATER_CALIBR_MAX_DRIFT_RAW      (1)    // mean change between two windows
+#define HEATER_CALIBR_TARGET_BAND_RAW    (10)
+#define HEATER_CALIBR_POINT_TIMEOUT_MS   (5UL * 60 * 1000)
+
+#define HEATER_CALIBR_MIN_DELTA_C        (50)
+#define HEATER_CALIBR_MIN_DELTA_RAW      (20)
+
+
+uint8_t heater_calibr_state = HEATER_CALIBR_STATE_IDLE;
+uint8_t heater_calibr_point;
+uint8_t heater_calibr_points_qty = 2;
+uint16_t heater_calibr_target_c[HEATER_CALIBR_MAX_POINTS] = {100, 400, 0, 0};
+uint16_t heater_calibr_ref_c;
+uint16_t heater_calibr_raw;
+uint8_t heater_calibr_heater_idx = HEATER_MAIN;
+
+static heater_t *calibr_heater;
+static uint16_t point_raw[HEATER_CALIBR_MAX_POINTS];
+static uint16_t point_c[HEATER_CALIBR_MAX_POINTS];
+static uint16_t target_raw;
+static uint8_t window_cnt;
+static uint16_t window_sum;
+static uint32_t window_sum_sq;
+static uint16_t window_mean_prev;
+static timer_t point_timer;
+
+
+
+
+static void heater_calibr_point_start(void);
+static uint16_t heater_calibr_target_raw(uint16_t target_c);
+static void heater_calibr_commit(void);
+static void heater_calibr_stop(void);
+
+
+
+
+// Guided calibration: for every target the heater is held in raw mode (is_tc_calibr) until
+// the signal is stable, then the averaged raw value waits for the reference temperature
+// (heater_calibr_ref_c + DEVICE_REG_CMD_HEATER_CALIBR_POINT). All points are validated and saved at once.
+void heater_calibr_start(void) {
+    uint8_t i;
+
+
+    if (heater_calibr_is_running()) return;
+    if ((heater_calibr_points_qty < 2) || (heater_calibr_points_qty > HEATER_CALIBR_MAX_POINTS) || (heater_calibr_heater_idx >= HEATER_QTY)) {
+        heater_calibr_state = HEATER_CALIBR_STATE_ERR_RESULT;
+        return;
+    }
+    for (i = 0; i < heater_calibr_points_qty; i++) {
+        if ((heater_calibr_target_c[i] == 0) || (heater_calibr_target_c[i] > HEATER_MAX_SETUP_TEMP_C) ||
+            ((i > 0) && (heater_calibr_target_c[i] <= heater_calibr_target_c[i - 1]))) {
+            heater_calibr_state = HEATER_CALIBR_STATE_ERR_RESULT;
+            return;
+        }
+    }
+
+    calibr_heater = &heater[heater_calibr_heater_idx];
+    if (calibr_heater == &heater[HEATER_MAIN]) {
+        #if (HEATER_AUTOTUNE_EN != 0)
+        heater_autotune_abort();
+        #endif
+        #if (HEATER_PROFILE_EN != 0)
+        heater_profile_abort();
+        #endif
+    }
+    heater_calibr_point = 0;
+    heater_calibr_point_start();
+}
+
+
+// Reference temperature of the current point is in heater_calibr_ref_c
+void heater_calibr_point_ref(void) {
+    uint32_t point_uv;
+    uint16_t cj_uv;
+
+
+    if (heater_calibr_state != HEATER_CALIBR_STATE_WAIT_REF) return;
+    if (heater_calibr_ref_c > TC_TYPE_K_TABLE_MAX_C) heater_calibr_ref_c = TC_TYPE_K_TABLE_MAX_C;
+
+    // Calibration points are stored for the cold junction at HEATER_TC_CALIBR_CJ_C16:
+    // E_cal = E(ref) - E(t_cj) + E(t_cj_cal)
+    point_uv = (uint32_t)tc_type_k_c16_to_uv(heater_calibr_ref_c << 4) + tc_type_k_c16_to_uv(HEATER_TC_CALIBR_CJ_C16);
+    cj_uv = tc_type_k_c16_to_uv(cjs_temperature);
+    if (point_uv > cj_uv) point_uv -= cj_uv;
+    else point_uv = 0;
+    if (point_uv > 0xFFFF) point_uv = 0xFFFF;
+
+    point_raw[heater_calibr_point] = heater_calibr_raw;
+    point_c[heater_calibr_point] = tc_type_k_uv_to_c((uint16_t)point_uv);
+
+    heater_calibr_point++;
+    if (heater_calibr_point < heater_calibr_points_qty) heater_calibr_point_start();
+    else heater_calibr_commit();
+}
+
+
+void heater_calibr_abort(void) {
+    if (!heater_calibr_is_running()) return;
+    heater_calibr_state = HEATER_CALIBR_STATE_ABORTED;
+    heater_calibr_stop();
+}
+
+
+bool heater_calibr_is_running(void) {
+    return ((heater_calibr_state == HEATER_CALIBR_STATE_SETTLE) || (heater_calibr_state == HEATER_CALIBR_STATE_WAIT_REF));
+}
+
+
+// Called from the control tick of every heater before the setpoint is used
+void heater_calibr_process(heater_t *h, uint16_t tc_raw) {
+    uint16_t mean;
+    uint32_t var_n2;
+
+
+    if (!heater_calibr_is_running() || (h != calibr_heater)) return;
+
+    h->is_tc_calibr = true;
+    h->setup_temperature_raw = target_raw;
+
+    if (systimer_triggered_ms(point_timer)) {
+        heater_calibr_state = HEATER_CALIBR_STATE_ERR_TIMEOUT;
+        heater_calibr_stop();
+        return;
+    }
+
+    if (heater_calibr_state != HEATER_CALIBR_STATE_SETTLE) return;
+
+    window_sum += tc_raw;
+    window_sum_sq += (uint32_t)tc_raw * tc_raw;
+    window_cnt++;
+    if (window_cnt < HEATER_CALIBR_WINDOW) return;
+
+    // N^2 * variance = N * sum(x^2) - sum(x)^2
+    mean = (window_sum + (HEATER_CALIBR_WINDOW / 2)) / HEATER_CALIBR_WINDOW;
+    var_n2 = (HEATER_CALIBR_WINDOW * window_sum_sq) - ((uint32_t)window_sum * window_sum);
+
+    if ((var_n2 <= HEATER_CALIBR_MAX_VAR_N2) &&
+        (window_mean_prev != 0xFFFF) &&
+        ((mean + HEATER_CALIBR_MAX_DRIFT_RAW) >= window_mean_prev) && (mean <= (window_mean_prev + HEATER_CALIBR_MAX_DRIFT_RAW)) &&
+        ((mean + HEATER_CALIBR_TARGET_BAND_RAW) >= target_raw) && (mean <= (target_raw + HEATER_CALIBR_TARGET_BAND_RAW))) {
+        heater_calibr_raw = mean;
+        heater_calibr_state = HEATER_CALIBR_STATE_WAIT_REF;
+    }
+
+    window_mean_prev = mean;
+    window_cnt = 0;
+    window_sum = 0;
+    window_sum_sq = 0;
+}
+
+
+
+
+static void heater_calibr_point_start(void) {
+    target_raw = heater_calibr_target_raw(heater_calibr_target_c[heater_calibr_point]);
+    heater_calibr_ref_c = heater_calibr_target_c[heater_calibr_point];
+    heater_calibr_raw = 0;
+    window_cnt = 0;
+    window_sum = 0;
+    window_sum_sq = 0;
+    window_mean_prev = 0xFFFF;
+    point_timer = systimer_set_ms(HEATER_CALIBR_POINT_TIMEOUT_MS);
+    heater_calibr_state = HEATER_CALIBR_STATE_SETTLE;
+}
+
+
+// Raw setpoint for the target by the current calibration, linear guess over the Type K range without it
+static uint16_t heater_calibr_target_raw(uint16_t target_c) {
+    uint16_t low, high, mid;
+
+
+    if (calibr_heater->tc_calibr.points_qty < 2) return ((uint32_t)target_c * ADC_MAX_CODE) / TC_TYPE_K_TABLE_MAX_C;
+
+    low = 0;
+    high = ADC_MAX_CODE - 1;
+    while (low < high) {
+        mid = (low + high) >> 1;
+        if (heater_tc_raw_to_c(calibr_heater, mid) < target_c) low = mid + 1;
+        else high = mid;
+    }
+
+    return low;
+}
+
+
+static void heater_calibr_commit(void) {
+    uint8_t i;
+
+
+    for (i = 0; i < (heater_calibr_points_qty - 1); i++) {
+        if ((point_c[i + 1] < (point_c[i] + HEATER_CALIBR_MIN_DELTA_C)) ||
+            (point_raw[i + 1] < (point_raw[i] + HEATER_CALIBR_MIN_DELTA_RAW))) {
+            heater_calibr_state = HEATER_CALIBR_STATE_ERR_RESULT;
+            heater_calibr_stop();
+            return;
+        }
+    }
+
+    calibr_heater->tc_calibr.points_qty = heater_calibr_points_qty;
+    for (i = 0; i < heater_calibr_points_qty; i++) {
+        calibr_heater->tc_calibr.x[i] = point_raw[i];
+        calibr_heater->tc_calibr.y[i] = point_c[i];
+    }
+    calibr_save(&calibr_heater->tc_calibr, &calibr_heater->calibr_tc_rec);
+    heater_tc_calibr_apply(calibr_heater);
+
+    heater_calibr_state = HEATER_CALIBR_STATE_DONE;
+    heater_calibr_stop();
+}
+
+
+static void heater_calibr_stop(void) {
+    calibr_heater->is_tc_calibr = false;
+    calibr_heater->setup_temperature_raw = 0;
+    calibr_heater->setup_temperature_c = 0;
+}
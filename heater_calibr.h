@@ -0,0 +1,39 @@
+#ifndef _HEATER_CALIBR_H_
+#define _HEATER_CALIBR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "heater_driver.h"
+
+
+#define HEATER_CALIBR_MAX_POINTS (4)
+
+
+typedef enum {
+    HEATER_CALIBR_STATE_IDLE = 0,
+    HEATER_CALIBR_STATE_SETTLE,      // heating to the point, waiting for a stable signal
+    HEATER_CALIBR_STATE_WAIT_REF,    // stable, waiting for the reference temperature (command)
+    HEATER_CALIBR_STATE_DONE,
+    HEATER_CALIBR_STATE_ERR_TIMEOUT,
+    HEATER_CALIBR_STATE_ERR_RESULT,
+    HEATER_CALIBR_STATE_ABORTED,
+} heater_calibr_state_t;
+
+
+extern uint8_t heater_calibr_state;   // heater_calibr_state_t
+extern uint8_t heater_calibr_point;
+extern uint8_t heater_calibr_points_qty;
+extern uint16_t heater_calibr_target_c[HEATER_CALIBR_MAX_POINTS];
+extern uint16_t heater_calibr_ref_c;
+extern uint16_t heater_calibr_raw;
+extern uint8_t heater_calibr_heater_idx;   // heater[] instance, latched at the start
+
+
+extern void heater_calibr_start(void);
+extern void heater_calibr_point_ref(void);
+extern void heater_calibr_abort(void);
+extern bool heater_calibr_is_running(void);
+extern void heater_calibr_process(heater_t *h, uint16_t tc_raw);
+
+
+#endif   // _HEATER_CALIBR_H_
@@ -8,176 +8,573 @@
 #include "systimer.h"
 #include "error_handler.h"
 #include "mcp9804_temp_sensor_driver.h"
+#include "pid_controller.h"
+#if (HEATER_AUTOTUNE_EN != 0)
+#include "heater_autotune.h"
+#endif
+#if (HEATER_PROFILE_EN != 0)
+#include "heater_profile.h"
+#endif
+#include "heater_stand.h"
+#include "heater_calibr.h"
+#include "tc_type_k.h"
+#include "calibr.h"
+#include "heater_supervisor.h"
+#include "pwm_driver.h"
+#include "eeprom_log.h"
+#include "eeprom_record.h"
 
 
 #define HEATER_MIN_DELTA_C             (30)
-#define HEATER_FAST_HEATERING_DELTA_C  (20)
 
+#define HEATER_PID_DEFAULT_KP          (1000 << PID_CONTROLLER_GAIN_SHIFT)   // OCR per C
+#define HEATER_PID_DEFAULT_KI          (53)                                  // Q4, OCR per C per tick (Ti ~ 30 s)
+#define HEATER_PID_DEFAULT_KD          (20000)                               // OCR per C/tick (Td ~ 2 s)
+#define HEATER_PID_KAW                 (4)                                   // Q4, 0.25
 
-uint16_t heater_setup_temperature_c;
-uint16_t heater_setup_temperature_raw;
-uint16_t heater_real_temperature_c;
-uint16_t cjs_temperature;
+#define HEATER_PWM_CS                  (2)        // F_CPU / 8
+#define HEATER_PWM_TOP                 ((F_CPU / 8 / HEATER_PWM_FREQ_HZ) - 1)   // Tim 1 timebase, if the heater is the first owner
+#if (HEATER_PWM_TOP > 0xFFFF) || (HEATER_PWM_TOP < 0xFF)
+#error "heater_driver: HEATER_PWM_FREQ_HZ out of range"
+#endif
+
+#define HEATER_SETTLE_BAND_C           (3)
+#define HEATER_SETTLE_HOLD_MS          (5000)
+
+#define HEATER_BOARD_ALERT_DUTY_MAX    (HEATER_OCR_MAX / 2)   // while the board is over mcp9804_t_upper_c
+
+
+typedef struct {
+    uint8_t pwm_ch;
+    uint8_t meas_ch;   // meas_adc_data.channel_index
+    uint16_t ee_addr_params;
+    uint16_t ee_addr_calibr_tc;
+} heater_config_t;
 
-bool is_heater_tc_calibr;
-uint16_t heater_cal_tc_t1_meas_raw;
-uint16_t heater_cal_tc_t2_meas_raw;
-uint16_t heater_ocr_calibr_k;
-uint16_t heater_cal_ocr_minimal_ocr;
+// EE_PART_HEATER_PARAMS record payload
+typedef struct {
+    uint16_t minimal_ocr;
+    uint16_t pid_kp;
+    uint16_t pid_ki;
+    uint16_t pid_kd;
+    uint16_t ssr_window_ms;
+    uint16_t out_mode;
+} heater_params_t;
 
-static const uint16_t heater_cal_tc_t1_c = 100;
+_Static_assert(sizeof(heater_params_t) == EE_REC_HEATER_PARAMS_SIZE, "heater_driver: heater_params_t size");
+
+
+heater_t heater[HEATER_QTY];
+uint16_t cjs_temperature;
+uint16_t heater_tc_conv_cycles;
+uint16_t heater_last_setup_temperature_c;
+
+static const heater_config_t heater_config[HEATER_QTY] = {
+    {
+        HEATER_PWM_CH,
+        MEAS_CH_HEATER_TC,
+        EE_PART_HEATER_PARAMS_ADDR,
+        EE_PART_CALIBR_HEATER_TC_ADDR,
+    },
+    #if (HEATER_QTY > 1)
+    {
+        HEATER_1_PWM_CH,
+        MEAS_CH_HEATER_1_TC,
+        EE_PART_HEATER_1_PARAMS_ADDR,
+        EE_PART_CALIBR_HEATER_1_TC_ADDR,
+    },
+    #endif
+};
+
+static const uint16_t heater_cal_tc_t1_c = 100;   // legacy two-point calibration, main heater only
 static const uint16_t heater_cal_tc_t2_c = 400;
-static timer_t heating_process_timer;
 static const uint32_t heating_process_timeout_ms = 90000;
+static timer_t heater_control_timer;
+static eeprom_log_t heater_setup_log;
+
+
+
+
+static void heater_instance_init(heater_t *h, const heater_config_t *config);
+static bool heater_params_load_legacy(heater_params_t *params);
+static void heater_instance_process(heater_t *h, bool is_main);
+static void heater_modes_abort(bool is_main);
+static bool heater_is_profile_running(void);
+static void heater_pwm_en(heater_t *h);
+static void heater_pwm_dis(heater_t *h);
+static void heater_ssr_process(heater_t *h);
+static void heater_out_limit(heater_t *h, uint16_t duty_max);
+static void heater_step_response_process(heater_t *h, uint16_t setup_temperature_c);
 
 
 
 
 void heater_init(void) {
-    bool is_incorrect_calibr;
-
-
-    // Tim 1 init
-    #define ICR1_VAL (65535)   // Need for TOP
-    ICR1H = (uint8_t)(ICR1_VAL >> 8);
-    ICR1L = (uint8_t)(ICR1_VAL >> 0);
-    OCR1AH = 0;
-    OCR1AL = 0;
-    OCR1BH = 0;
-    OCR1BL = 0;
-    #define WGM1 (14)           // Fast PWM, TOP = ICR1
-    TCCR1A = ((WGM1 & 0b11) << WGM10)  |
-             (0 << COM1B0) |    // 0 - OCx disconnected
-             (0 << COM1A0);     // Toggle OC1A on Compare Match     // set in process
-    TCCR1B = (0 << ICNC1) |     // Input Capture Noise Canceler
-             (0 << ICES1) |     // Input Capture Edge Select
-             (((WGM1 & 0b1100) >> 2) << WGM12)  |
-             (2 << CS10);       // Clock Select: 0x00-0x05 -> 0/1/8/64/256/1024
-    // Interrupt Mask Register
-    TIMSK1 = (0 << OCIE1B) |    // Output Compare B Match Interrupt
-             (0 << OCIE1A) |    // Output Compare A Match Interrupt
-             (0 << TOIE1);      // Overflow Interrupt
+    uint8_t i;
+
 
     mcp9804_temp_sensor_driver_init();
 
-    eeprom_driver_read_16(EE_ADDR_CALIBR_TC_T1_MEAS_RAW, &heater_cal_tc_t1_meas_raw);
-    eeprom_driver_read_16(EE_ADDR_CALIBR_TC_T2_MEAS_RAW, &heater_cal_tc_t2_meas_raw);
-    eeprom_driver_read_16(EE_ADDR_OCR_CALIBR_K, &heater_ocr_calibr_k);
-    eeprom_driver_read_16(EE_ADDR_OCR_CALIBR_MINIMAL_OCR, &heater_cal_ocr_minimal_ocr);
-
-    // Check values
-    is_incorrect_calibr = false;
-    if (heater_cal_tc_t1_meas_raw > 0xF000) is_incorrect_calibr = true;
-    if (heater_cal_tc_t2_meas_raw > 0xF000) is_incorrect_calibr = true;
-    if (heater_ocr_calibr_k > 1000) is_incorrect_calibr = true;
-    if (heater_cal_ocr_minimal_ocr > 0xF000) is_incorrect_calibr = true;
-
-    if (is_incorrect_calibr) {
-        heater_cal_tc_t1_meas_raw = 0;
-        heater_cal_tc_t2_meas_raw = 1;
-        heater_ocr_calibr_k = 1;
-        heater_cal_ocr_minimal_ocr = 0;
-        eh_state |= EH_STATUS_FLAG_CAL_ERR;
+    cjs_temperature = 25 << 4;
+    for (i = 0; i < HEATER_QTY; i++) heater_instance_init(&heater[i], &heater_config[i]);
+
+    // Last user setpoint, the heater is not started at power up
+    eeprom_log_init(&heater_setup_log, EE_PART_LAST_TEMP_LOG_ADDR, EE_PART_LAST_TEMP_LOG_SIZE);
+    if (!eeprom_log_get(&heater_setup_log, &heater_last_setup_temperature_c) || (heater_last_setup_temperature_c > HEATER_MAX_SETUP_TEMP_C)) {
+        heater_last_setup_temperature_c = 0;
     }
 
-    is_heater_tc_calibr = false;
-    heater_setup_temperature_c = 0;
-    heater_setup_temperature_raw = 0;
-    heater_real_temperature_c = 999;
-    cjs_temperature = 25 << 4;
-    heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
+    heater_control_timer = systimer_set_ms(HEATER_CONTROL_PERIOD_MS);
+    #if (HEATER_PROFILE_EN != 0)
+    heater_profile_init();
+    #endif
+    heater_stand_init();
 }
 
 
 void heater_process(void) {
-    static bool is_heater_enabled = false;
-    static uint16_t heater_setup_temperature_perv = 0xFFFF;
+    uint8_t i;
+
+
+    // Board over-temperature event is applied at once, not on the next control tick
+    if (mcp9804_temp_sensor_is_alert()) {
+        for (i = 0; i < HEATER_QTY; i++) heater_out_limit(&heater[i], HEATER_BOARD_ALERT_DUTY_MAX);
+    }
+    for (i = 0; i < HEATER_QTY; i++) heater_ssr_process(&heater[i]);
+    heater_stand_process();
+    eeprom_log_process(&heater_setup_log);
+
+    // Fixed control rate, PID Ki/Kd are scaled to HEATER_CONTROL_PERIOD_MS
+    if (!systimer_triggered_ms(heater_control_timer)) return;
+    heater_control_timer += HEATER_CONTROL_PERIOD_MS;
+
+    if (mcp9804_temp_sensor_get_temp(&cjs_temperature)) cjs_temperature = 25 << 4;
+
+    // User setpoints only: switching off, profiles and calibration do not overwrite the last temperature
+    if ((heater[HEATER_MAIN].setup_temperature_c != 0) && (heater[HEATER_MAIN].setup_temperature_c <= HEATER_MAX_SETUP_TEMP_C) &&
+        !heater_is_profile_running() && !heater_calibr_is_running()) {
+        heater_last_setup_temperature_c = heater[HEATER_MAIN].setup_temperature_c;
+        eeprom_log_set(&heater_setup_log, heater_last_setup_temperature_c);
+    }
+
+    for (i = 0; i < HEATER_QTY; i++) heater_instance_process(&heater[i], (i == HEATER_MAIN));
+}
+
+
+
+
+// Heater output is on (any mode), used for the fan interlock
+bool heater_is_enabled(heater_t *h) {
+    return h->is_enabled;
+}
+
+
+// Current (RAM register) params to the EEPROM record
+void heater_params_save(heater_t *h) {
+    heater_params_t params;
+
+
+    params.minimal_ocr = h->cal_ocr_minimal_ocr;
+    params.pid_kp = h->pid.kp;
+    params.pid_ki = h->pid.ki;
+    params.pid_kd = h->pid.kd;
+    params.ssr_window_ms = h->ssr_window_ms;
+    params.out_mode = h->out_mode;
+    eeprom_record_save(&h->params_rec, &params);
+}
+
+
+void heater_params_save_all(void) {
+    uint8_t i;
+
+
+    for (i = 0; i < HEATER_QTY; i++) heater_params_save(&heater[i]);
+}
+
+
+
+
+static void heater_instance_init(heater_t *h, const heater_config_t *config) {
+    heater_params_t params;
+    bool is_params;
+
+
+    h->pwm_ch = config->pwm_ch;
+    h->meas_ch = config->meas_ch;
+
+    // Runs on any timebase of the channel, duty is scaled to its TOP
+    h->is_pwm = pwm_driver_alloc(h->pwm_ch, HEATER_PWM_TOP, HEATER_PWM_CS, true);
+
+    // Params record, the loose legacy cells of the main heater are imported once
+    eeprom_record_init(&h->params_rec, config->ee_addr_params, EE_REC_HEATER_PARAMS_SIZE, EE_REC_HEATER_PARAMS_VERSION);
+    is_params = eeprom_record_load(&h->params_rec, &params);
+    if (!is_params && (h == &heater[HEATER_MAIN]) && heater_params_load_legacy(&params)) {
+        eeprom_record_save(&h->params_rec, &params);
+        is_params = true;
+    }
+    if (!is_params) {
+        params.minimal_ocr = 0;
+        params.pid_kp = HEATER_PID_DEFAULT_KP;
+        params.pid_ki = HEATER_PID_DEFAULT_KI;
+        params.pid_kd = HEATER_PID_DEFAULT_KD;
+        params.ssr_window_ms = HEATER_SSR_WINDOW_DEF_MS;
+        params.out_mode = HEATER_OUT_MODE_PWM;
+        eh_state |= EH_STATUS_FLAG_CAL_ERR;
+    }
+
+    h->cal_ocr_minimal_ocr = params.minimal_ocr;
+    h->ssr_window_ms = params.ssr_window_ms;
+    h->out_mode = params.out_mode;
+    if (h->out_mode > HEATER_OUT_MODE_SSR) h->out_mode = HEATER_OUT_MODE_PWM;
+    if (h->ssr_window_ms < HEATER_SSR_WINDOW_MIN_MS) h->ssr_window_ms = HEATER_SSR_WINDOW_DEF_MS;
+    h->out_mode_prev = h->out_mode;
+
+    pid_controller_init(&h->pid, params.pid_kp, params.pid_ki, params.pid_kd, HEATER_PID_KAW, HEATER_OCR_MAX);
+
+    eeprom_record_init(&h->calibr_tc_rec, config->ee_addr_calibr_tc, CALIBR_RECORD_SIZE, EE_REC_CALIBR_VERSION);
+    if (!calibr_load(&h->tc_calibr, &h->calibr_tc_rec) && (h == &heater[HEATER_MAIN])) {
+        // Legacy two-point calibration
+        h->tc_calibr.points_qty = 2;
+        eeprom_driver_read_16(EE_ADDR_CALIBR_TC_T1_MEAS_RAW, &h->tc_calibr.x[0]);
+        eeprom_driver_read_16(EE_ADDR_CALIBR_TC_T2_MEAS_RAW, &h->tc_calibr.x[1]);
+        h->tc_calibr.y[0] = heater_cal_tc_t1_c;
+        h->tc_calibr.y[1] = heater_cal_tc_t2_c;
+    }
+    if (!heater_tc_calibr_apply(h)) eh_state |= EH_STATUS_FLAG_CAL_ERR;
+
+    h->is_tc_calibr = false;
+    h->setup_temperature_c = 0;
+    h->setup_temperature_raw = 0;
+    h->setup_temperature_prev = 0xFFFF;
+    h->real_temperature_c = 999;
+    h->is_real_temperature_valid = false;
+    h->settling_time_100ms = 0;
+    h->overshoot_c = 0;
+    h->is_step_settled = true;
+    h->heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
+    h->is_enabled = false;
+    h->out_duty = 0;
+    heater_supervisor_reset(&h->supervisor);
+}
+
+
+// Loose cells of the firmware before the records, erased or broken values are rejected
+static bool heater_params_load_legacy(heater_params_t *params) {
+    uint8_t out_mode;
+
+
+    eeprom_driver_read_16(EE_ADDR_OCR_CALIBR_MINIMAL_OCR, &params->minimal_ocr);
+    eeprom_driver_read_16(EE_ADDR_PID_KP, &params->pid_kp);
+    eeprom_driver_read_16(EE_ADDR_PID_KI, &params->pid_ki);
+    eeprom_driver_read_16(EE_ADDR_PID_KD, &params->pid_kd);
+    eeprom_driver_read_16(EE_ADDR_HEATER_SSR_WINDOW_MS, &params->ssr_window_ms);
+    eeprom_driver_read_8(EE_ADDR_HEATER_OUT_MODE, &out_mode);
+    params->out_mode = out_mode;
+
+    if (params->minimal_ocr > 0xF000) return false;
+    if ((params->pid_kp == 0) || (params->pid_kp == 0xFFFF)) return false;
+    if ((params->pid_ki == 0xFFFF) || (params->pid_kd == 0xFFFF)) return false;
+    if (params->ssr_window_ms == 0xFFFF) params->ssr_window_ms = HEATER_SSR_WINDOW_DEF_MS;
+    return true;
+}
+
+
+// Control tick of one heater. Autotune, profiles and stand belong to the main heater.
+static void heater_instance_process(heater_t *h, bool is_main) {
     uint16_t heater_ocr_value;
-    uint16_t heater_minimal_ocr;
-    int64_t tmp;
+    uint32_t heater_feed_forward;
+    uint16_t tc_raw;
+    uint16_t tc_c;
     uint16_t heater_setup_temperature;
     uint16_t heater_temperature_delta_c;
+    uint16_t supervisor_setup_temperature;
+    uint8_t supervisor_fault;
+    bool is_autotune;
+    uint16_t tc_conv_start;
+    uint32_t tc_conv_cycles;
+
+
+    // Output mode can be changed in run time (RAM registers)
+    if (h->out_mode > HEATER_OUT_MODE_SSR) h->out_mode = HEATER_OUT_MODE_PWM;
+    if (h->ssr_window_ms < HEATER_SSR_WINDOW_MIN_MS) h->ssr_window_ms = HEATER_SSR_WINDOW_MIN_MS;
+    if (h->out_mode != h->out_mode_prev) {
+        h->out_mode_prev = h->out_mode;
+        heater_pwm_dis(h);
+    }
 
+    // Conversion time of the main heater sample only (raw -> C), in CPU cycles, saturated at 0xFFFF
+    tc_raw = meas_adc_data.channel_index[h->meas_ch];
+    tc_conv_start = systimer_get_ticks();
+    tc_c = heater_tc_raw_to_c(h, tc_raw);
+    if (is_main) {
+        tc_conv_cycles = (uint32_t)(uint16_t)(systimer_get_ticks() - tc_conv_start) * SYSTIMER_TICK_CYCLES;
+        heater_tc_conv_cycles = (tc_conv_cycles > 0xFFFF) ? 0xFFFF : (uint16_t)tc_conv_cycles;
+    }
 
-    if (mcp9804_temp_sensor_get_temp(&cjs_temperature)) cjs_temperature = 25 << 4;
+    heater_calibr_process(h, tc_raw);
 
-    if (is_heater_tc_calibr) {
-        heater_setup_temperature = heater_setup_temperature_raw;
-        heater_real_temperature_c = meas_adc_data.channel_name.heater_tc;
+    if (h->is_tc_calibr) {
+        heater_setup_temperature = h->setup_temperature_raw;
+        h->real_temperature_c = tc_raw;
+        h->is_real_temperature_valid = true;
+        // Calibration mode is used to fix a missing calibration
+        if ((eh_state & ~EH_STATUS_FLAG_CAL_ERR) != 0) {
+            heater_modes_abort(is_main);
+            heater_pwm_dis(h);
+            return;
+        }
     }
     else {
-        heater_setup_temperature = heater_setup_temperature_c;
+        #if (HEATER_PROFILE_EN != 0)
+        if (is_main) heater_profile_process(tc_c);
+        #endif
+        heater_setup_temperature = h->setup_temperature_c;
+        if (is_main && !heater_is_profile_running()) heater_setup_temperature = heater_stand_setpoint(heater_setup_temperature, tc_c);
         if (heater_setup_temperature > HEATER_MAX_SETUP_TEMP_C) heater_setup_temperature = HEATER_MAX_SETUP_TEMP_C;
+        h->real_temperature_c = tc_c;
+        h->is_real_temperature_valid = true;
 
-        // Convert raw to temperature
-        // y = y1 + ((y2 - y1) / (x2 - x1)) * (x - x1)
-        // y = y1 + ((y2 - y1) * (x - x1)) / (x2 - x1)
-        if (meas_adc_data.channel_name.heater_tc > 5) {
-            // (x - x1)
-            tmp = meas_adc_data.channel_name.heater_tc;
-            ///tmp -= cjs_comp;
-            tmp -= heater_cal_tc_t1_meas_raw;
-            // * (y2 - y1)) / (x2 - x1)
-            tmp = (((heater_cal_tc_t2_c - heater_cal_tc_t1_c) * tmp) / (heater_cal_tc_t2_meas_raw - heater_cal_tc_t1_meas_raw));
-            // + y1
-            tmp += (heater_cal_tc_t1_c);
-            heater_real_temperature_c = (uint16_t)tmp;
-        }
-        else {
-            heater_real_temperature_c = 0;
-        }
-
+        // Error flags are shared, a fault of any heater stops all of them
         if (eh_state != 0) {
-            TCCR1A = ((WGM1 & 0b11) << WGM10)  |
-                     (0 << COM1B0) |    // 0 - OCx disconnected
-                     (0 << COM1A0);     // 0 - OCx disconnected
-            is_heater_enabled = false;
+            heater_modes_abort(is_main);
+            heater_pwm_dis(h);
             return;
         }
     }
 
-    if (heater_setup_temperature_perv != heater_setup_temperature) {
-        heater_setup_temperature_perv = heater_setup_temperature;
-        heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
+    if (h->setup_temperature_prev != heater_setup_temperature) {
+        h->setup_temperature_prev = heater_setup_temperature;
+        h->heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
+        h->step_start_ms = systimer_get_ms();
+        h->settling_time_100ms = 0;
+        h->overshoot_c = 0;
+        h->is_step_in_band = false;
+        h->is_step_settled = false;
     }
 
 
-    if (heater_setup_temperature == 0) {
-        if (is_heater_enabled) {
-            TCCR1A = ((WGM1 & 0b11) << WGM10)  |
-                     (0 << COM1B0) |    // 0 - OCx disconnected
-                     (0 << COM1A0);     // 0 - OCx disconnected
-            is_heater_enabled = false;
-        }
+    #if (HEATER_AUTOTUNE_EN != 0)
+    is_autotune = is_main && heater_autotune_is_running();
+    if (is_autotune && h->is_tc_calibr) {
+        heater_autotune_abort();
+        is_autotune = false;
     }
-    else if (!is_heater_enabled) {
-        TCCR1A = ((WGM1 & 0b11) << WGM10)  |
-             (0 << COM1B0) |    // 0 - OCx disconnected
-             (2 << COM1A0);     // Toggle OC1A on Compare Match
-        is_heater_enabled = true;
-    }    
+    #else
+    is_autotune = false;
+    #endif
 
+    if ((heater_setup_temperature == 0) && !is_autotune) {
+        heater_pwm_dis(h);
+        pid_controller_reset(&h->pid);
+        heater_ocr_value = 0;
+    }
+    else {
+        heater_pwm_en(h);
 
-    if (heater_real_temperature_c < heater_setup_temperature) {
-        heater_temperature_delta_c = heater_setup_temperature - heater_real_temperature_c;
-        if (heater_temperature_delta_c > HEATER_MIN_DELTA_C) {
-            if (systimer_triggered_ms(heating_process_timer)) eh_state |= EH_STATUS_FLAG_HEATER_ERR;
+        #if (HEATER_AUTOTUNE_EN != 0)
+        if (is_autotune) {
+            // Relay oscillation, has own timeout and overtemperature protection
+            heater_ocr_value = heater_autotune_process(h->real_temperature_c);
+            h->heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
         }
-        else {
-            heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
+        else
+        #endif
+        {
+            if (h->real_temperature_c < heater_setup_temperature) {
+                heater_temperature_delta_c = heater_setup_temperature - h->real_temperature_c;
+                if (heater_temperature_delta_c > HEATER_MIN_DELTA_C) {
+                    if (systimer_triggered_ms(h->heating_process_timer)) eh_state |= EH_STATUS_FLAG_HEATER_ERR;
+                }
+                else {
+                    h->heating_process_timer = systimer_set_ms(heating_process_timeout_ms);
+                }
+            }
+
+            // Static feed-forward: power needed to hold the setpoint, profile ramps look ahead
+            #if (HEATER_PROFILE_EN != 0)
+            if (is_main && heater_profile_is_running()) {
+                heater_feed_forward = heater_profile_feed_forward();
+            }
+            else
+            #endif
+            {
+                heater_feed_forward = (uint32_t)h->cal_ocr_minimal_ocr * heater_setup_temperature;
+                if (heater_feed_forward > HEATER_OCR_MAX) heater_feed_forward = HEATER_OCR_MAX;
+            }
+
+            heater_ocr_value = pid_controller_process(&h->pid, (int16_t)heater_setup_temperature, (int16_t)h->real_temperature_c, (uint16_t)heater_feed_forward);
+
+            if (!h->is_tc_calibr) heater_step_response_process(h, heater_setup_temperature);
         }
+    }
+
+    // Safety supervisor, cuts the output in this tick
+    supervisor_setup_temperature = heater_setup_temperature;
+    #if (HEATER_AUTOTUNE_EN != 0)
+    if (is_autotune) supervisor_setup_temperature = heater_autotune_setpoint_c;
+    #endif
+    supervisor_fault = heater_supervisor_process(&h->supervisor, tc_raw, tc_c, supervisor_setup_temperature, heater_ocr_value, !h->is_tc_calibr);
+    if (supervisor_fault != 0) {
+        eh_state |= supervisor_fault;
+        heater_modes_abort(is_main);
+        heater_pwm_dis(h);
+        return;
+    }
+
+    if (mcp9804_temp_sensor_is_alert() && (heater_ocr_value > HEATER_BOARD_ALERT_DUTY_MAX)) heater_ocr_value = HEATER_BOARD_ALERT_DUTY_MAX;
+    h->out_duty = heater_ocr_value;
+    if (h->out_mode == HEATER_OUT_MODE_PWM) pwm_driver_set_duty(h->pwm_ch, heater_ocr_value);
+}
+
+
+static void heater_modes_abort(bool is_main) {
+    if (is_main) {
+        #if (HEATER_AUTOTUNE_EN != 0)
+        heater_autotune_abort();
+        #endif
+        #if (HEATER_PROFILE_EN != 0)
+        heater_profile_abort();
+        #endif
+    }
+    heater_calibr_abort();
+}
+
+
+static bool heater_is_profile_running(void) {
+    #if (HEATER_PROFILE_EN != 0)
+    return heater_profile_is_running();
+    #else
+    return false;
+    #endif
+}
+
 
-        if (!is_heater_tc_calibr && (heater_temperature_delta_c > HEATER_FAST_HEATERING_DELTA_C)) heater_ocr_value = 0x5FFF;   // fast heating
-        else heater_ocr_value = heater_temperature_delta_c * heater_ocr_calibr_k;
-        heater_minimal_ocr = heater_cal_ocr_minimal_ocr * heater_setup_temperature;
-        if (heater_ocr_value < heater_minimal_ocr) heater_ocr_value = heater_minimal_ocr;
+static void heater_pwm_en(heater_t *h) {
+    if (h->is_enabled) return;
+    if (h->out_mode == HEATER_OUT_MODE_PWM) {
+        pwm_driver_connect(h->pwm_ch, true);
     }
     else {
-        heater_ocr_value = 0;
+        // First window starts on the next heater_ssr_process() call
+        h->ssr_window_start_ms = systimer_get_ms() - h->ssr_window_ms;
+        h->ssr_on_ms = 0;
     }
+    h->is_enabled = true;
+}
+
+
+static void heater_pwm_dis(heater_t *h) {
+    if (!h->is_pwm) return;
+    pwm_driver_connect(h->pwm_ch, false);
+    pwm_driver_set_ocr(h->pwm_ch, 0);
+    pwm_driver_set_pin(h->pwm_ch, false);
+    h->out_duty = 0;
+    h->is_enabled = false;
+}
+
+
+static void heater_out_limit(heater_t *h, uint16_t duty_max) {
+    if (h->out_duty <= duty_max) return;
+    h->out_duty = duty_max;
+    if (h->out_mode == HEATER_OUT_MODE_PWM) pwm_driver_set_duty(h->pwm_ch, duty_max);
+    else if (h->ssr_on_ms > (((uint32_t)duty_max * h->ssr_window_ms) >> 16)) h->ssr_on_ms = ((uint32_t)duty_max * h->ssr_window_ms) >> 16;
+}
+
+
+// Time-proportional output for SSR / triac loads: one on pulse per window, called every main loop.
+// On time is latched at the window start, shorter than HEATER_SSR_MIN_SWITCH_MS pulses or gaps are dropped.
+static void heater_ssr_process(heater_t *h) {
+    uint32_t time_ms;
+    uint32_t window_time_ms;
+
+
+    if (!h->is_enabled || (h->out_mode != HEATER_OUT_MODE_SSR)) return;
 
-    OCR1AH = (uint8_t)(heater_ocr_value >> 8);
-    OCR1AL = (uint8_t)(heater_ocr_value >> 0);
+    time_ms = systimer_get_ms();
+    window_time_ms = time_ms - h->ssr_window_start_ms;
+    if (window_time_ms >= h->ssr_window_ms) {
+        // Keep the window grid if the main loop was late by less than a window
+        if (window_time_ms < (2UL * h->ssr_window_ms)) h->ssr_window_start_ms += h->ssr_window_ms;
+        else h->ssr_window_start_ms = time_ms;
+        window_time_ms = time_ms - h->ssr_window_start_ms;
+
+        h->ssr_on_ms = ((uint32_t)h->out_duty * h->ssr_window_ms + 0x8000) >> 16;
+        if (h->ssr_on_ms < HEATER_SSR_MIN_SWITCH_MS) h->ssr_on_ms = 0;
+        else if ((h->ssr_window_ms - h->ssr_on_ms) < HEATER_SSR_MIN_SWITCH_MS) h->ssr_on_ms = h->ssr_window_ms;
+    }
+
+    pwm_driver_set_pin(h->pwm_ch, (window_time_ms < h->ssr_on_ms));
+}
+
+
+// Raw -> thermocouple EMF -> C, with cold junction compensation
+uint16_t heater_tc_raw_to_c(heater_t *h, uint16_t tc_raw) {
+    uint32_t tc_uv;
+
+
+    if (tc_raw <= 5) return 0;
+
+    tc_uv = calibr_calc(&h->tc_calibr, tc_raw);
+    // E(t) = E(t - t_cj) + E(t_cj)
+    tc_uv += tc_type_k_c16_to_uv(cjs_temperature);
+    if (tc_uv > 0xFFFF) tc_uv = 0xFFFF;
+
+    return tc_type_k_uv_to_c((uint16_t)tc_uv);
+}
+
+
+// Calibration points are (raw, C) with the cold junction at HEATER_TC_CALIBR_CJ_C16, convert them
+// to thermocouple EMF and precompute the segments
+bool heater_tc_calibr_apply(heater_t *h) {
+    uint8_t i;
+    uint16_t cal_cj_uv;
+    uint16_t point_uv;
+
+
+    cal_cj_uv = tc_type_k_c16_to_uv(HEATER_TC_CALIBR_CJ_C16);
+    for (i = 0; i < h->tc_calibr.points_qty; i++) {
+        point_uv = tc_type_k_c16_to_uv(h->tc_calibr.y[i] << 4);
+        if (point_uv > cal_cj_uv) h->tc_calibr.y[i] = point_uv - cal_cj_uv;
+        else h->tc_calibr.y[i] = 0;
+    }
+
+    return calibr_update(&h->tc_calibr);
+}
+
+
+// Settling time (into +-HEATER_SETTLE_BAND_C for HEATER_SETTLE_HOLD_MS) and overshoot of the last setpoint step
+static void heater_step_response_process(heater_t *h, uint16_t setup_temperature_c) {
+    uint16_t overshoot_c;
+    uint16_t error_c;
+    uint32_t time_ms;
+
+
+    if (h->is_step_settled) return;
+
+    time_ms = systimer_get_ms();
+
+    if (h->real_temperature_c > setup_temperature_c) {
+        overshoot_c = h->real_temperature_c - setup_temperature_c;
+        if (overshoot_c > h->overshoot_c) h->overshoot_c = overshoot_c;
+        error_c = overshoot_c;
+    }
+    else {
+        error_c = setup_temperature_c - h->real_temperature_c;
+    }
+
+    if (error_c <= HEATER_SETTLE_BAND_C) {
+        if (!h->is_step_in_band) {
+            h->is_step_in_band = true;
+            h->step_in_band_ms = time_ms;
+        }
+        else if ((time_ms - h->step_in_band_ms) >= HEATER_SETTLE_HOLD_MS) {
+            h->settling_time_100ms = (h->step_in_band_ms - h->step_start_ms) / 100;
+            h->is_step_settled = true;
+        }
+    }
+    else {
+        h->is_step_in_band = false;
+    }
 }
 
 
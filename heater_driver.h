@@ -4,25 +4,89 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "eeprom_driver.h"
+#include "pid_controller.h"
+#include "calibr.h"
+#include "eeprom_record.h"
+#include "systimer.h"
+#include "heater_supervisor.h"
 
 
-#define HEATER_MAX_SETUP_TEMP_C (500)
+#define HEATER_MAX_SETUP_TEMP_C  (500)
+#define HEATER_CONTROL_PERIOD_MS (100)
+#define HEATER_OCR_MAX           (65535)
+#define HEATER_TC_CALIBR_CJ_C16  (25 << 4)   // cold junction temperature of the stored calibration points
 
+// Output mode: MOSFET - hardware PWM, SSR - time-proportional (slow PWM) on the same pin
+#define HEATER_OUT_MODE_PWM      (0)
+#define HEATER_OUT_MODE_SSR      (1)
+#ifndef HEATER_PWM_FREQ_HZ
+#define HEATER_PWM_FREQ_HZ       (1000)   // Tim 1 channels, Tim 2 (OC2) is fixed to F_CPU / 8 / 256
+#endif
+#define HEATER_SSR_MIN_SWITCH_MS (20)     // minimal on / off time, one mains period
+#define HEATER_SSR_WINDOW_MIN_MS (10 * HEATER_SSR_MIN_SWITCH_MS)
+#define HEATER_SSR_WINDOW_DEF_MS (1000)
 
-extern uint16_t heater_setup_temperature_c;
-extern uint16_t heater_setup_temperature_raw;
-extern uint16_t heater_real_temperature_c;
-extern uint16_t cjs_temperature;
+// Heater instances, each one has own output, thermocouple channel, calibration, PID and supervisor
+#ifndef HEATER_QTY
+#define HEATER_QTY               (1)
+#endif
+#if (HEATER_QTY < 1) || (HEATER_QTY > 2)
+#error "heater_driver: wrong HEATER_QTY"
+#endif
+#define HEATER_MAIN              (0)   // hot air gun: fan, autotune, profiles and stand
 
-extern bool is_heater_tc_calibr;
-extern uint16_t heater_cal_tc_t1_meas_raw;
-extern uint16_t heater_cal_tc_t2_meas_raw;
-extern uint16_t heater_ocr_calibr_k;
-extern uint16_t heater_cal_ocr_minimal_ocr;
+
+typedef struct {
+    uint16_t setup_temperature_c;
+    uint16_t setup_temperature_raw;   // is_tc_calibr mode setpoint
+    uint16_t real_temperature_c;      // raw in is_tc_calibr mode
+    bool is_real_temperature_valid;   // false until the first sample
+
+    bool is_tc_calibr;
+    calibr_t tc_calibr;               // raw -> thermocouple EMF, uV
+    uint16_t cal_ocr_minimal_ocr;
+
+    pid_controller_t pid;
+    uint16_t settling_time_100ms;
+    uint16_t overshoot_c;
+
+    uint8_t out_mode;
+    uint16_t ssr_window_ms;
+
+    // Driver state
+    uint8_t pwm_ch;
+    uint8_t meas_ch;
+    eeprom_record_t params_rec;       // minimal OCR, PID, output mode
+    eeprom_record_t calibr_tc_rec;
+    bool is_pwm;
+    bool is_enabled;
+    uint16_t out_duty;
+    uint8_t out_mode_prev;
+    uint32_t ssr_window_start_ms;
+    uint16_t ssr_on_ms;
+    uint16_t setup_temperature_prev;
+    timer_t heating_process_timer;
+    uint32_t step_start_ms;
+    uint32_t step_in_band_ms;
+    bool is_step_in_band;
+    bool is_step_settled;
+    heater_supervisor_t supervisor;
+} heater_t;
+
+
+extern heater_t heater[HEATER_QTY];
+extern uint16_t cjs_temperature;   // shared cold junction sensor
+extern uint16_t heater_tc_conv_cycles;
+extern uint16_t heater_last_setup_temperature_c;   // main heater, wear-leveled EEPROM log
 
 
 extern void heater_init(void);
 extern void heater_process(void);
+extern bool heater_tc_calibr_apply(heater_t *h);
+extern uint16_t heater_tc_raw_to_c(heater_t *h, uint16_t tc_raw);
+extern bool heater_is_enabled(heater_t *h);
+extern void heater_params_save(heater_t *h);
+extern void heater_params_save_all(void);
 
 
 #endif   // _HEATER_DRIVER_H_
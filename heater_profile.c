@@ -0,0 +1,202 @@
+#include "heater_profile.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "heater_driver.h"
+#include "heater_autotune.h"
+#include "eeprom_driver.h"
+#include "device_registers.h"
+#include "systimer.h"
+
+
+#define HEATER_PROFILE_BAND_C       (5)      // hold starts when the real temperature is in the band
+#define HEATER_PROFILE_LOOKAHEAD_MS (3000)   // feed-forward leads the setpoint by about the heater lag
+
+#if ((HEATER_PROFILE_QTY * HEATER_PROFILE_EE_BLOCK_SIZE) > EE_PART_HEATER_PROFILES_SIZE)
+#error "heater_profile: profiles do not fit EE_PART_HEATER_PROFILES"
+#endif
+
+
+uint8_t heater_profile_idx = 0;
+uint8_t heater_profile_state = HEATER_PROFILE_STATE_IDLE;
+uint8_t heater_profile_segment;
+uint16_t heater_profile_ramp_ff;
+
+static heater_profile_segment_t segments[HEATER_PROFILE_MAX_SEGMENTS];
+static uint8_t segments_qty;
+static uint16_t segment_start_c;
+static uint32_t segment_ramp_ms;
+static uint32_t phase_start_ms;
+static bool is_hold;
+static uint16_t lookahead_setpoint_c;
+
+
+
+
+static bool heater_profile_load(uint8_t idx);
+static void heater_profile_segment_start(uint16_t start_c);
+static uint16_t heater_profile_ramp_setpoint(uint32_t ramp_time_ms);
+
+
+
+
+void heater_profile_init(void) {
+    eeprom_driver_read_16(EE_ADDR_HEATER_PROFILE_RAMP_FF, &heater_profile_ramp_ff);
+    if (heater_profile_ramp_ff == 0xFFFF) heater_profile_ramp_ff = 0;
+}
+
+
+// Runs profile heater_profile_idx, the ramp of the first segment starts from the current temperature
+void heater_profile_start(void) {
+    if (!heater_profile_load(heater_profile_idx)) {
+        heater_profile_state = HEATER_PROFILE_STATE_ERR_LOAD;
+        return;
+    }
+
+    heater_autotune_abort();
+    heater_profile_segment = 0;
+    heater_profile_segment_start(heater[HEATER_MAIN].real_temperature_c);
+    heater_profile_state = HEATER_PROFILE_STATE_RUN;
+}
+
+
+void heater_profile_abort(void) {
+    if (heater_profile_state != HEATER_PROFILE_STATE_RUN) return;
+    heater_profile_state = HEATER_PROFILE_STATE_ABORTED;
+    heater[HEATER_MAIN].setup_temperature_c = 0;
+}
+
+
+bool heater_profile_is_running(void) {
+    return (heater_profile_state == HEATER_PROFILE_STATE_RUN);
+}
+
+
+// Called from the main heater control tick, sets its setup_temperature_c
+void heater_profile_process(uint16_t real_temperature_c) {
+    heater_profile_segment_t *segment;
+    uint32_t time_ms;
+    bool is_in_band;
+
+
+    if (heater_profile_state != HEATER_PROFILE_STATE_RUN) return;
+    if (heater_autotune_is_running()) {
+        heater_profile_abort();
+        return;
+    }
+
+    segment = &segments[heater_profile_segment];
+    time_ms = systimer_get_ms() - phase_start_ms;
+
+    if (!is_hold) {
+        heater[HEATER_MAIN].setup_temperature_c = heater_profile_ramp_setpoint(time_ms);
+        lookahead_setpoint_c = heater_profile_ramp_setpoint(time_ms + HEATER_PROFILE_LOOKAHEAD_MS);
+        if (time_ms < segment_ramp_ms) return;
+
+        if (segment->target_c == 0) {
+            is_in_band = true;
+        }
+        else if (segment->target_c >= segment_start_c) {
+            is_in_band = ((real_temperature_c + HEATER_PROFILE_BAND_C) >= segment->target_c);
+        }
+        else {
+            is_in_band = (real_temperature_c <= (segment->target_c + HEATER_PROFILE_BAND_C));
+        }
+        if (!is_in_band) return;
+
+        is_hold = true;
+        phase_start_ms += time_ms;
+        time_ms = 0;
+    }
+
+    if (time_ms < ((uint32_t)segment->hold_s * 1000)) return;
+
+    heater_profile_segment++;
+    if (heater_profile_segment >= segments_qty) {
+        heater[HEATER_MAIN].setup_temperature_c = 0;
+        heater_profile_state = HEATER_PROFILE_STATE_DONE;
+        return;
+    }
+    heater_profile_segment_start(segment->target_c);
+}
+
+
+// Look-ahead feed-forward: static power of the setpoint HEATER_PROFILE_LOOKAHEAD_MS ahead
+// plus the power to heat the mass along the ramp
+uint16_t heater_profile_feed_forward(void) {
+    heater_profile_segment_t *segment;
+    uint32_t feed_forward;
+
+
+    segment = &segments[heater_profile_segment];
+    feed_forward = (uint32_t)heater[HEATER_MAIN].cal_ocr_minimal_ocr * lookahead_setpoint_c;
+    if (!is_hold && (segment->target_c > segment_start_c)) {
+        feed_forward += ((uint32_t)heater_profile_ramp_ff * segment->rate_c10_per_s) / 10;
+    }
+    if (feed_forward > HEATER_OCR_MAX) feed_forward = HEATER_OCR_MAX;
+
+    return (uint16_t)feed_forward;
+}
+
+
+
+
+static bool heater_profile_load(uint8_t idx) {
+    uint16_t ee_addr;
+    uint8_t i;
+
+
+    if (idx >= HEATER_PROFILE_QTY) return false;
+    ee_addr = EE_PART_HEATER_PROFILES_ADDR + ((uint16_t)idx * HEATER_PROFILE_EE_BLOCK_SIZE);
+
+    eeprom_driver_read_8(ee_addr, &segments_qty);
+    if ((segments_qty == 0) || (segments_qty > HEATER_PROFILE_MAX_SEGMENTS)) return false;
+    ee_addr++;
+
+    for (i = 0; i < segments_qty; i++) {
+        eeprom_driver_read_16(ee_addr, &segments[i].target_c);
+        eeprom_driver_read_16((ee_addr + 2), &segments[i].rate_c10_per_s);
+        eeprom_driver_read_16((ee_addr + 4), &segments[i].hold_s);
+        ee_addr += 6;
+        if (segments[i].target_c > HEATER_MAX_SETUP_TEMP_C) return false;
+    }
+
+    return true;
+}
+
+
+static void heater_profile_segment_start(uint16_t start_c) {
+    heater_profile_segment_t *segment;
+    uint16_t delta_c;
+
+
+    segment = &segments[heater_profile_segment];
+    if (start_c > HEATER_MAX_SETUP_TEMP_C) start_c = HEATER_MAX_SETUP_TEMP_C;
+    segment_start_c = start_c;
+
+    if (segment->target_c > start_c) delta_c = segment->target_c - start_c;
+    else delta_c = start_c - segment->target_c;
+    if (segment->rate_c10_per_s == 0) segment_ramp_ms = 0;
+    else segment_ramp_ms = ((uint32_t)delta_c * 10000) / segment->rate_c10_per_s;
+
+    phase_start_ms = systimer_get_ms();
+    is_hold = false;
+}
+
+
+// Linear ramp segment_start_c -> target_c in segment_ramp_ms, delta_c * time_ms fits 32 bits
+// (delta <= HEATER_MAX_SETUP_TEMP_C, ramp <= delta * 10 s)
+static uint16_t heater_profile_ramp_setpoint(uint32_t ramp_time_ms) {
+    heater_profile_segment_t *segment;
+    uint16_t delta_c;
+
+
+    segment = &segments[heater_profile_segment];
+    if (ramp_time_ms >= segment_ramp_ms) return segment->target_c;
+
+    if (segment->target_c > segment_start_c) {
+        delta_c = segment->target_c - segment_start_c;
+        return segment_start_c + (uint16_t)(((uint32_t)delta_c * ramp_time_ms) / segment_ramp_ms);
+    }
+    delta_c = segment_start_c - segment->target_c;
+    return segment_start_c - (uint16_t)(((uint32_t)delta_c * ramp_time_ms) / segment_ramp_ms);
+}
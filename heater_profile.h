@@ -0,0 +1,49 @@
+#ifndef _HEATER_PROFILE_H_
+#define _HEATER_PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#if (HEATER_QTY > 1)
+#define HEATER_PROFILE_QTY          (1)   // EEPROM is taken by the second heater
+#else
+#define HEATER_PROFILE_QTY          (2)
+#endif
+#define HEATER_PROFILE_MAX_SEGMENTS (6)
+// EEPROM block: segments qty (1 byte) + segments (target_c, rate_c10_per_s, hold_s) BE - HHLL
+#define HEATER_PROFILE_EE_BLOCK_SIZE (1 + (HEATER_PROFILE_MAX_SEGMENTS * 6))
+
+
+// Ramp from the previous setpoint to target_c, then hold target_c for hold_s.
+// rate_c10_per_s = 0 - step. target_c = 0 - heater off, the segment ends with the ramp.
+typedef struct {
+    uint16_t target_c;
+    uint16_t rate_c10_per_s;   // 0.1 C/s
+    uint16_t hold_s;
+} heater_profile_segment_t;
+
+typedef enum {
+    HEATER_PROFILE_STATE_IDLE = 0,
+    HEATER_PROFILE_STATE_RUN,
+    HEATER_PROFILE_STATE_DONE,
+    HEATER_PROFILE_STATE_ERR_LOAD,
+    HEATER_PROFILE_STATE_ABORTED,
+} heater_profile_state_t;
+
+
+extern uint8_t heater_profile_idx;
+extern uint8_t heater_profile_state;     // heater_profile_state_t
+extern uint8_t heater_profile_segment;
+extern uint16_t heater_profile_ramp_ff;  // feed-forward OCR per 1 C/s of the setpoint slope
+
+
+extern void heater_profile_init(void);
+extern void heater_profile_start(void);
+extern void heater_profile_abort(void);
+extern bool heater_profile_is_running(void);
+extern void heater_profile_process(uint16_t real_temperature_c);
+extern uint16_t heater_profile_feed_forward(void);
+
+
+#endif   // _HEATER_PROFILE_H_
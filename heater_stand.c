@@ -0,0 +1,130 @@
+#include "heater_stand.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio_driver.h"
+#include "systimer.h"
+#include "eeprom_driver.h"
+#include "device_registers.h"
+#include "heater_driver.h"
+
+
+#define HEATER_STAND_PIN_STATE        (GPIOB_GET(GPIOB_HEATER_STAND_PIN))   // reed switch to GND, 0 - handle on the stand
+#define HEATER_STAND_PULL_UP_EN       (GPIOB_SET(GPIOB_HEATER_STAND_PIN))
+#define HEATER_STAND_SAMPLE_MS        (10)
+#define HEATER_STAND_DEBOUNCE_SAMPLES (5)
+
+#define HEATER_STAND_SETBACK_DELAY_DEF_S (30)
+#define HEATER_STAND_SLEEP_DELAY_DEF_S   (600)
+#define HEATER_STAND_SETBACK_DEF_C       (150)
+
+// Fast boost after pickup: setpoint is raised until the element is close to the user setpoint
+#define HEATER_STAND_BOOST_C          (40)
+#define HEATER_STAND_BOOST_BAND_C     (10)
+#define HEATER_STAND_BOOST_MAX_MS     (20000)
+
+
+uint8_t heater_stand_state;
+uint16_t heater_stand_setback_delay_s;
+uint16_t heater_stand_sleep_delay_s;
+uint16_t heater_stand_setback_c;
+
+static timer_t heater_stand_sample_timer;
+static uint8_t heater_stand_debounce_cnt;
+static bool is_on_stand;
+static uint32_t on_stand_start_ms;
+static timer_t heater_stand_boost_timer;
+static uint16_t heater_stand_setup_prev_c;
+
+
+
+
+void heater_stand_init(void) {
+    HEATER_STAND_PULL_UP_EN;
+
+    eeprom_driver_read_16(EE_ADDR_HEATER_STAND_SETBACK_DELAY_S, &heater_stand_setback_delay_s);
+    eeprom_driver_read_16(EE_ADDR_HEATER_STAND_SLEEP_DELAY_S, &heater_stand_sleep_delay_s);
+    eeprom_driver_read_16(EE_ADDR_HEATER_STAND_SETBACK_C, &heater_stand_setback_c);
+    if (heater_stand_setback_delay_s == 0xFFFF) heater_stand_setback_delay_s = HEATER_STAND_SETBACK_DELAY_DEF_S;
+    if (heater_stand_sleep_delay_s == 0xFFFF) heater_stand_sleep_delay_s = HEATER_STAND_SLEEP_DELAY_DEF_S;
+    if (heater_stand_setback_c > HEATER_MAX_SETUP_TEMP_C) heater_stand_setback_c = HEATER_STAND_SETBACK_DEF_C;
+
+    heater_stand_state = HEATER_STAND_STATE_ACTIVE;
+    heater_stand_debounce_cnt = 0;
+    is_on_stand = false;
+    heater_stand_setup_prev_c = 0;
+    heater_stand_sample_timer = systimer_set_ms(HEATER_STAND_SAMPLE_MS);
+}
+
+
+// Reed input debounce, called every main loop
+void heater_stand_process(void) {
+    if (!systimer_triggered_ms(heater_stand_sample_timer)) return;
+    heater_stand_sample_timer += HEATER_STAND_SAMPLE_MS;
+
+    if (HEATER_STAND_PIN_STATE == 0) {
+        if (heater_stand_debounce_cnt < HEATER_STAND_DEBOUNCE_SAMPLES) {
+            heater_stand_debounce_cnt++;
+        }
+        else if (!is_on_stand) {
+            is_on_stand = true;
+            on_stand_start_ms = systimer_get_ms();
+        }
+    }
+    else {
+        if (heater_stand_debounce_cnt > 0) heater_stand_debounce_cnt--;
+        else is_on_stand = false;
+    }
+}
+
+
+// Called from the heater control tick, returns the setpoint to run
+uint16_t heater_stand_setpoint(uint16_t setup_temperature_c, uint16_t real_temperature_c) {
+    uint32_t idle_s;
+    uint16_t boost_c;
+
+
+    // Heater switched on or setpoint changed: the user is at the station, idle time starts again
+    if (setup_temperature_c != heater_stand_setup_prev_c) {
+        heater_stand_setup_prev_c = setup_temperature_c;
+        on_stand_start_ms = systimer_get_ms();
+        if ((heater_stand_state == HEATER_STAND_STATE_SETBACK) || (heater_stand_state == HEATER_STAND_STATE_SLEEP)) {
+            heater_stand_state = HEATER_STAND_STATE_ACTIVE;
+        }
+    }
+
+    if ((setup_temperature_c == 0) || (heater_stand_setback_delay_s == 0)) {
+        heater_stand_state = HEATER_STAND_STATE_ACTIVE;
+        return setup_temperature_c;
+    }
+
+    if (is_on_stand) {
+        idle_s = (systimer_get_ms() - on_stand_start_ms) / 1000;
+        if (idle_s >= heater_stand_sleep_delay_s) heater_stand_state = HEATER_STAND_STATE_SLEEP;
+        else if (idle_s >= heater_stand_setback_delay_s) heater_stand_state = HEATER_STAND_STATE_SETBACK;
+    }
+    else if ((heater_stand_state == HEATER_STAND_STATE_SETBACK) || (heater_stand_state == HEATER_STAND_STATE_SLEEP)) {
+        heater_stand_state = HEATER_STAND_STATE_BOOST;
+        heater_stand_boost_timer = systimer_set_ms(HEATER_STAND_BOOST_MAX_MS);
+    }
+
+    switch (heater_stand_state) {
+        case HEATER_STAND_STATE_SETBACK:
+            if (heater_stand_setback_c < setup_temperature_c) return heater_stand_setback_c;
+            return setup_temperature_c;
+
+        case HEATER_STAND_STATE_SLEEP:
+            return 0;
+
+        case HEATER_STAND_STATE_BOOST:
+            if (((real_temperature_c + HEATER_STAND_BOOST_BAND_C) >= setup_temperature_c) || systimer_triggered_ms(heater_stand_boost_timer)) {
+                heater_stand_state = HEATER_STAND_STATE_ACTIVE;
+                return setup_temperature_c;
+            }
+            boost_c = setup_temperature_c + HEATER_STAND_BOOST_C;
+            if (boost_c > HEATER_MAX_SETUP_TEMP_C) boost_c = HEATER_MAX_SETUP_TEMP_C;
+            return boost_c;
+
+        default:
+            return setup_temperature_c;
+    }
+}
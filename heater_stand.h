@@ -0,0 +1,27 @@
+#ifndef _HEATER_STAND_H_
+#define _HEATER_STAND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+typedef enum {
+    HEATER_STAND_STATE_ACTIVE = 0,   // in hand or setback delay is running
+    HEATER_STAND_STATE_SETBACK,
+    HEATER_STAND_STATE_SLEEP,
+    HEATER_STAND_STATE_BOOST,        // picked up, overdrive to the setpoint
+} heater_stand_state_t;
+
+
+extern uint8_t heater_stand_state;   // heater_stand_state_t
+extern uint16_t heater_stand_setback_delay_s;   // 0 - stand function disabled
+extern uint16_t heater_stand_sleep_delay_s;
+extern uint16_t heater_stand_setback_c;
+
+
+extern void heater_stand_init(void);
+extern void heater_stand_process(void);
+extern uint16_t heater_stand_setpoint(uint16_t setup_temperature_c, uint16_t real_temperature_c);
+
+
+#endif   // _HEATER_STAND_H_
@@ -0,0 +1,86 @@
+#include "heater_supervisor.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "heater_driver.h"
+#include "meas.h"
+#include "error_handler.h"
+
+
+// Evaluation window, called once per heater control tick
+#define HEATER_SUPERVISOR_WINDOW_TICKS      (3000 / HEATER_CONTROL_PERIOD_MS)
+// Heating model: below (setpoint - band) with average duty >= MIN_DUTY the element must rise
+// at least FULL_POWER_RISE_C * duty per window
+#define HEATER_SUPERVISOR_MIN_DUTY          (HEATER_OCR_MAX / 2)
+#define HEATER_SUPERVISOR_FULL_POWER_RISE_C (10)
+#define HEATER_SUPERVISOR_BAND_C            (15)
+// Output stuck on: still rising well above the setpoint
+#define HEATER_SUPERVISOR_MAX_OVERSHOOT_C   (50)
+#define HEATER_SUPERVISOR_STUCK_RISE_C      (5)
+#define HEATER_SUPERVISOR_MAX_TEMP_C        (HEATER_MAX_SETUP_TEMP_C + 50)
+
+// Thermocouple ADC signatures
+#define HEATER_TC_OPEN_RAW                  (ADC_MAX_CODE - 4)   // amplifier saturated, input pulled up
+#define HEATER_TC_OPEN_SAMPLES              (3)
+#define HEATER_TC_ZERO_RAW                  (5)                  // detached thermocouple reads near zero
+#define HEATER_TC_SHORT_FLAT_RAW            (1)                  // shorted: alive but does not follow the heater
+
+
+void heater_supervisor_reset(heater_supervisor_t *s) {
+    s->window_ticks = 0;
+    s->tc_open_samples = 0;
+}
+
+
+// Returns EH_STATUS_FLAG_HEATER_xxx_ERR bits, caller must cut the output in the same tick.
+// is_temperature_check_en = false - temperature is not in C (calibration), only the signal is checked.
+uint8_t heater_supervisor_process(heater_supervisor_t *s, uint16_t tc_raw, uint16_t real_temperature_c, uint16_t setup_temperature_c, uint16_t ocr, bool is_temperature_check_en) {
+    uint8_t fault = 0;
+    uint16_t avg_duty;
+    uint16_t expected_rise_c;
+
+
+    if (tc_raw >= HEATER_TC_OPEN_RAW) {
+        if (s->tc_open_samples < HEATER_TC_OPEN_SAMPLES) s->tc_open_samples++;
+        else fault |= EH_STATUS_FLAG_HEATER_TC_OPEN_ERR;
+    }
+    else {
+        s->tc_open_samples = 0;
+    }
+
+    if (is_temperature_check_en && (real_temperature_c > HEATER_SUPERVISOR_MAX_TEMP_C)) fault |= EH_STATUS_FLAG_HEATER_RUNAWAY_ERR;
+
+
+    if (s->window_ticks == 0) {
+        s->window_duty_sum = 0;
+        s->window_start_c = real_temperature_c;
+        s->window_raw_min = tc_raw;
+        s->window_raw_max = tc_raw;
+    }
+    s->window_duty_sum += ocr;
+    if (tc_raw < s->window_raw_min) s->window_raw_min = tc_raw;
+    if (tc_raw > s->window_raw_max) s->window_raw_max = tc_raw;
+    s->window_ticks++;
+    if (s->window_ticks < HEATER_SUPERVISOR_WINDOW_TICKS) return fault;
+    s->window_ticks = 0;
+
+    avg_duty = s->window_duty_sum / HEATER_SUPERVISOR_WINDOW_TICKS;
+
+    if (avg_duty >= HEATER_SUPERVISOR_MIN_DUTY) {
+        if (s->window_raw_max <= HEATER_TC_ZERO_RAW) {
+            fault |= EH_STATUS_FLAG_HEATER_TC_OPEN_ERR;
+        }
+        else if (is_temperature_check_en && ((real_temperature_c + HEATER_SUPERVISOR_BAND_C) < setup_temperature_c)) {
+            expected_rise_c = ((uint32_t)HEATER_SUPERVISOR_FULL_POWER_RISE_C * avg_duty) / HEATER_OCR_MAX;
+            if ((s->window_raw_max - s->window_raw_min) <= HEATER_TC_SHORT_FLAT_RAW) fault |= EH_STATUS_FLAG_HEATER_TC_SHORT_ERR;
+            else if (real_temperature_c < (s->window_start_c + expected_rise_c)) fault |= EH_STATUS_FLAG_HEATER_RUNAWAY_ERR;
+        }
+    }
+
+    if (is_temperature_check_en &&
+        (real_temperature_c > (setup_temperature_c + HEATER_SUPERVISOR_MAX_OVERSHOOT_C)) &&
+        (real_temperature_c >= (s->window_start_c + HEATER_SUPERVISOR_STUCK_RISE_C))) {
+        fault |= EH_STATUS_FLAG_HEATER_RUNAWAY_ERR;
+    }
+
+    return fault;
+}
@@ -0,0 +1,21 @@
+#ifndef _HEATER_SUPERVISOR_H_
+#define _HEATER_SUPERVISOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+typedef struct {
+    uint8_t window_ticks;
+    uint32_t window_duty_sum;
+    uint16_t window_start_c;
+    uint16_t window_raw_min, window_raw_max;
+    uint8_t tc_open_samples;
+} heater_supervisor_t;
+
+
+extern void heater_supervisor_reset(heater_supervisor_t *s);
+extern uint8_t heater_supervisor_process(heater_supervisor_t *s, uint16_t tc_raw, uint16_t real_temperature_c, uint16_t setup_temperature_c, uint16_t ocr, bool is_temperature_check_en);
+
+
+#endif   // _HEATER_SUPERVISOR_H_
@@ -6,115 +6,237 @@
 #include "systimer.h"
 #include "error_handler.h"
 #include "gpio_driver.h"
+#include "calibr.h"
+#include "eeprom_record.h"
+#include "device_registers.h"
+#include "pwm_driver.h"
+#if (HEATER_EN != 0)
+#include "mcp9804_temp_sensor_driver.h"
+#endif
+#if (PHOTODIODE_EN != 0)
+#include "photodiode.h"
+#endif
 
 
 #define LED_FB_CURRENT_SHOUNT_10_OHM (33)
 #define LED_FB_VOLTAGE_100_K (1572)
-#define LED_EN (GPIOB_SET(2))
-#define LED_DIS (GPIOB_RESET(2))
+#define LED_EN (GPIOB_SET(GPIOB_LED_EN_PIN))
+#define LED_DIS (GPIOB_RESET(GPIOB_LED_EN_PIN))
+
+#define LED_PWM_TOP (128)   //// 64 ???
+#define LED_PWM_CS  (1)     // F_CPU / 1
 
 #define LED_DRIVER_MAX_SETUP_CURRENT_MA (200)   ////
 #define LED_DRIVER_MAX_FATAL_CURRENT_MA (300)   ////
 #define LED_DRIVER_MAX_FATAL_VOLTAGE_MV (15000) ////
+#define LED_DRIVER_BOARD_ALERT_PCT      (50)    // current limit while the board is over mcp9804_t_upper_c
+#define LED_DRIVER_GATE_HOLD_SWEEPS     (2)     // current feedback settling after the pulse front
+#define LED_DRIVER_LIGHT_ERR_DIV        (4)     // light loop: part of the relative light error corrected per sweep
+#define LED_DRIVER_LIGHT_MAX_STEP_MA    (10)
+#define LED_DRIVER_LIGHT_DEADBAND_SHIFT (6)     // 1/64 of the light setpoint
+
+
+#if (PHOTODIODE_EN != 0)
+// EE_PART_LED_PARAMS record payload
+typedef struct {
+    uint16_t reg_mode;
+    uint16_t light_max;
+} led_params_t;
+
+_Static_assert(sizeof(led_params_t) == EE_REC_LED_PARAMS_SIZE, "led_driver: led_params_t size");
+#endif
 
 
 uint8_t led_current_pct;
+uint16_t led_current_ma;
+#if (PHOTODIODE_EN != 0)
+uint8_t led_reg_mode;
+uint16_t led_light_max;
+#endif
 
-static bool is_led_err, is_led_en;
+static bool is_led_err, is_led_en, is_led_pwm;
+static bool is_led_gate_on = true;
+static volatile bool is_led_cutoff;
+static uint8_t led_gate_hold;
 static uint16_t led_ocr;
+static calibr_t led_current_calibr;   // raw -> mA
+static eeprom_record_t led_current_calibr_rec;
+#if (PHOTODIODE_EN != 0)
+static eeprom_record_t led_params_rec;
+#endif
 
-static const uint16_t led_driver_max_fatal_current_raw = ((uint32_t)LED_DRIVER_MAX_FATAL_CURRENT_MA * (uint32_t)ADC_MAX_CODE * (uint32_t)LED_FB_CURRENT_SHOUNT_10_OHM) / ((uint32_t)ADC_REF_MV * 10);
 static const uint16_t led_driver_max_fatal_voltage_raw = ((uint32_t)LED_DRIVER_MAX_FATAL_VOLTAGE_MV * (uint32_t)ADC_MAX_CODE * 100) / ((uint32_t)ADC_REF_MV * 1572);
 
 
+#if (PHOTODIODE_EN != 0)
+static void led_driver_params_load(void);
+static bool led_driver_is_light_mode(void);
+static uint16_t led_driver_light_process(uint8_t current_pct, uint16_t setup_ma);
+#endif
+
+
 void led_driver_init(void) {
     LED_DIS;
 
-    // Tim 1 init
-    #define ICR1_VAL (128)   // TOP   //// 64 ???
-    ICR1H = (uint8_t)(ICR1_VAL >> 8);
-    ICR1L = (uint8_t)(ICR1_VAL >> 0);
-    OCR1AH = 0;
-    OCR1AL = 0;
-    OCR1BH = 0;
-    OCR1BL = 0;
-    #define WGM1 (14)           // Fast PWM, TOP = ICR1
-    TCCR1A = ((WGM1 & 0b11) << WGM10)  |
-             (0 << COM1B0) |    // 0 - OCx disconnected
-             (0 << COM1A0);     // Toggle OC1A on Compare Match
-    TCCR1B = (0 << ICNC1) |     // Input Capture Noise Canceler
-             (0 << ICES1) |     // Input Capture Edge Select
-             (((WGM1 & 0b1100) >> 2) << WGM12)  |
-             (1 << CS10);       // Clock Select: 0x00-0x05 -> 0/1/8/64/256/1024
-    // Interrupt Mask Register
-    TIMSK |= (0 << OCIE1B) |    // Output Compare B Match Interrupt
-            (0 << OCIE1A) |    // Output Compare A Match Interrupt
-            (0 << TOIE1);      // Overflow Interrupt
+    is_led_pwm = pwm_driver_alloc(LED_PWM_CH, LED_PWM_TOP, LED_PWM_CS, false);
+
+    eeprom_record_init(&led_current_calibr_rec, EE_PART_CALIBR_LED_ADDR, CALIBR_RECORD_SIZE, EE_REC_CALIBR_VERSION);
+    if ((!calibr_load(&led_current_calibr, &led_current_calibr_rec) || !calibr_update(&led_current_calibr)) && !led_driver_calibr_import()) {
+        // Nominal shunt
+        led_current_calibr.points_qty = 2;
+        led_current_calibr.x[0] = 0;
+        led_current_calibr.y[0] = 0;
+        led_current_calibr.x[1] = ADC_MAX_CODE - 1;
+        led_current_calibr.y[1] = ((uint32_t)(ADC_MAX_CODE - 1) * (uint32_t)ADC_REF_MV * 10) / ((uint32_t)ADC_MAX_CODE * (uint32_t)LED_FB_CURRENT_SHOUNT_10_OHM);
+        calibr_update(&led_current_calibr);
+    }
+
+    #if (PHOTODIODE_EN != 0)
+    led_driver_params_load();
+    #endif
 
     is_led_err = false;
     is_led_en = false;
     led_current_pct = 0;
+    led_current_ma = 0;
+}
+
+
+// Raw points written over the CLI to EE_PART_CALIBR_LED_RAW are validated and saved as the record
+bool led_driver_calibr_import(void) {
+    calibr_t calibr;
+
+
+    if (!calibr_load_raw(&calibr, EE_PART_CALIBR_LED_RAW_ADDR) || !calibr_update(&calibr)) return false;
+    led_current_calibr = calibr;
+    calibr_save(&led_current_calibr, &led_current_calibr_rec);
+    return true;
+}
+
+
+#if (PHOTODIODE_EN != 0)
+// Current (RAM register) regulation mode and light full scale to the EEPROM record
+void led_driver_params_save(void) {
+    led_params_t params;
+
+
+    params.reg_mode = led_reg_mode;
+    params.light_max = led_light_max;
+    eeprom_record_save(&led_params_rec, &params);
+}
+#endif
+
+
+// Pulse mode: the output is switched in the caller's time, OCR is kept for the next pulse
+void led_driver_set_gate(bool is_on) {
+    if (is_on == is_led_gate_on) return;
+    is_led_gate_on = is_on;
+    if (!is_led_en || is_led_err || is_led_cutoff) return;
+
+    pwm_driver_connect(LED_PWM_CH, is_on);
+    if (is_on) {
+        led_gate_hold = LED_DRIVER_GATE_HOLD_SWEEPS;
+        LED_EN;
+    }
+    else {
+        LED_DIS;
+    }
+}
+
+
+// Also called from the timer irq: the output is off at once, the driver is switched off by the
+// next led_driver_process(). Only the enable pin is touched here (single bit access).
+void led_driver_cutoff(void) {
+    LED_DIS;
+    is_led_cutoff = true;
 }
 
 
 void led_driver_process(void) {
     static uint8_t led_current_pct_prev = 0xFF;
-    static uint32_t led_current_raw;
+    static uint16_t led_current_setup_ma;
     static uint8_t eh_skip;
+    uint8_t current_pct;
 
 
     if (led_current_pct > 100) led_current_pct = 100;
-    if (is_led_err) return;
+    if (is_led_err || !is_led_pwm) return;
 
-    if (led_current_pct != led_current_pct_prev) {
-        led_current_pct_prev = led_current_pct;
+    current_pct = led_current_pct;
+    #if (HEATER_EN != 0)
+    // Board over-temperature: the alert is asserted above the upper and the critical limit, the exposure goes on throttled
+    if (mcp9804_temp_sensor_is_alert() && (current_pct > LED_DRIVER_BOARD_ALERT_PCT)) current_pct = LED_DRIVER_BOARD_ALERT_PCT;
+    #endif
+    if (is_led_cutoff) {
+        if (is_led_en) current_pct = 0;   // switched off below
+        else is_led_cutoff = false;
+    }
 
-        if (led_current_pct > 0) {
-            led_current_raw = LED_DRIVER_MAX_SETUP_CURRENT_MA;
-            led_current_raw = led_current_raw * led_current_pct;
-            //led_current_raw = led_current_raw / 100;
-            led_current_raw = led_current_raw * (uint32_t)ADC_MAX_CODE * (uint32_t)LED_FB_CURRENT_SHOUNT_10_OHM;
-            led_current_raw = led_current_raw / ADC_REF_MV;
-            led_current_raw = led_current_raw / (10 * 100);
+    if (current_pct != led_current_pct_prev) {
+        if (current_pct > 0) {
+            #if (PHOTODIODE_EN != 0)
+            // Light mode keeps the trimmed setpoint, scaled to the new level
+            if (led_driver_is_light_mode() && is_led_en) led_current_setup_ma = ((uint32_t)led_current_setup_ma * current_pct) / led_current_pct_prev;
+            else led_current_setup_ma = ((uint16_t)LED_DRIVER_MAX_SETUP_CURRENT_MA * current_pct) / 100;
+            if (led_current_setup_ma > LED_DRIVER_MAX_SETUP_CURRENT_MA) led_current_setup_ma = LED_DRIVER_MAX_SETUP_CURRENT_MA;
+            #else
+            led_current_setup_ma = ((uint16_t)LED_DRIVER_MAX_SETUP_CURRENT_MA * current_pct) / 100;
+            #endif
 
             if (!is_led_en) {
                 is_led_en = true;
                 eh_skip = 10;
                 led_ocr = 0;
-                OCR1AH = (uint8_t)led_ocr >> 8;
-                OCR1AL = (uint8_t)led_ocr;
-                TCCR1A |= (2 << COM1A0); // 0 - OCB connected
-                LED_EN;
+                pwm_driver_set_ocr(LED_PWM_CH, led_ocr);
+                if (is_led_gate_on) {
+                    pwm_driver_connect(LED_PWM_CH, true);
+                    LED_EN;
+                }
             }
         }
         else if (is_led_en) {
             is_led_en = false;
             led_ocr = 0;
-            OCR1AH = (uint8_t)led_ocr >> 8;
-            OCR1AL = (uint8_t)led_ocr;
-            TCCR1A &= ~(3 << COM1A0); // 0 - OCB disconnected
+            pwm_driver_set_ocr(LED_PWM_CH, led_ocr);
+            pwm_driver_connect(LED_PWM_CH, false);
             LED_DIS;
         }
+        led_current_pct_prev = current_pct;
     }
 
-    if (meas_adc_data.channel_name.led_current < led_current_raw) {
-        if (led_ocr < 0xFFFF) led_ocr++;
+    led_current_ma = calibr_calc(&led_current_calibr, meas_adc_data.channel_name.led_current);
+
+    #if (PHOTODIODE_EN != 0)
+    // Light mode: the outer loop moves the current setpoint, the current loop below is the inner one
+    if (led_driver_is_light_mode() && is_led_en && is_led_gate_on && (led_gate_hold == 0)) {
+        led_current_setup_ma = led_driver_light_process(current_pct, led_current_setup_ma);
     }
-    else {
-        if (led_ocr > 0) led_ocr--;
+    #endif
+
+    // Pulse off and the pulse front: OCR is held
+    if (led_gate_hold > 0) {
+        led_gate_hold--;
+    }
+    else if (is_led_gate_on) {
+        if (led_current_ma < led_current_setup_ma) {
+            if (led_ocr < LED_PWM_TOP) led_ocr++;
+        }
+        else {
+            if (led_ocr > 0) led_ocr--;
+        }
     }
 
     if (eh_skip == 0) {
-        if (meas_adc_data.channel_name.led_current > led_driver_max_fatal_current_raw) {
+        if (led_current_ma > LED_DRIVER_MAX_FATAL_CURRENT_MA) {
             is_led_err = true;
             led_ocr = 0;
-            TCCR1A &= ~(3 << COM1A0); // 0 - OCB disconnected
+            pwm_driver_connect(LED_PWM_CH, false);
             LED_DIS;
         }
         if (meas_adc_data.channel_name.led_voltage > led_driver_max_fatal_voltage_raw) {
             is_led_err = true;
             led_ocr = 0;
-            TCCR1A &= ~(3 << COM1A0); // 0 - OCB disconnected
+            pwm_driver_connect(LED_PWM_CH, false);
             LED_DIS;
         }
     }
@@ -122,6 +244,52 @@ void led_driver_process(void) {
         eh_skip--;
     }
     
-    OCR1AH = (uint8_t)led_ocr >> 8;
-    OCR1AL = (uint8_t)led_ocr;
+    pwm_driver_set_ocr(LED_PWM_CH, led_ocr);
+}
+
+
+
+
+#if (PHOTODIODE_EN != 0)
+static void led_driver_params_load(void) {
+    led_params_t params;
+
+
+    eeprom_record_init(&led_params_rec, EE_PART_LED_PARAMS_ADDR, EE_REC_LED_PARAMS_SIZE, EE_REC_LED_PARAMS_VERSION);
+    if (!eeprom_record_load(&led_params_rec, &params) || (params.reg_mode > LED_REG_MODE_LIGHT)) {
+        params.reg_mode = LED_REG_MODE_CURRENT;
+        params.light_max = 0;
+    }
+    led_reg_mode = params.reg_mode;
+    led_light_max = params.light_max;
+}
+
+
+// Light mode falls back to the current one without a photodiode calibration or full scale
+static bool led_driver_is_light_mode(void) {
+    return ((led_reg_mode == LED_REG_MODE_LIGHT) && photodiode_is_calibr && (led_light_max != 0));
+}
+
+
+// Current setpoint is corrected by 1/LED_DRIVER_LIGHT_ERR_DIV of the relative light error per sweep,
+// limited to LED_DRIVER_LIGHT_MAX_STEP_MA and LED_DRIVER_MAX_SETUP_CURRENT_MA
+static uint16_t led_driver_light_process(uint8_t current_pct, uint16_t setup_ma) {
+    int32_t light_err;
+    int32_t delta_ma;
+
+
+    light_err = (((uint32_t)led_light_max * current_pct) / 100) - (int32_t)photodiode_irradiance;
+    if ((light_err < 0 ? -light_err : light_err) <= (int32_t)(led_light_max >> LED_DRIVER_LIGHT_DEADBAND_SHIFT)) return setup_ma;
+
+    if (photodiode_irradiance == 0) delta_ma = LED_DRIVER_LIGHT_MAX_STEP_MA;
+    else delta_ma = ((int32_t)setup_ma * light_err) / ((int32_t)photodiode_irradiance * LED_DRIVER_LIGHT_ERR_DIV);
+    if (delta_ma == 0) delta_ma = (light_err > 0) ? 1 : -1;
+    if (delta_ma > LED_DRIVER_LIGHT_MAX_STEP_MA) delta_ma = LED_DRIVER_LIGHT_MAX_STEP_MA;
+    if (delta_ma < -LED_DRIVER_LIGHT_MAX_STEP_MA) delta_ma = -LED_DRIVER_LIGHT_MAX_STEP_MA;
+
+    delta_ma += setup_ma;
+    if (delta_ma < 0) delta_ma = 0;
+    if (delta_ma > LED_DRIVER_MAX_SETUP_CURRENT_MA) delta_ma = LED_DRIVER_MAX_SETUP_CURRENT_MA;
+    return (uint16_t)delta_ma;
 }
+#endif
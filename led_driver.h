@@ -5,11 +5,30 @@
 #include <stdbool.h>
 
 
+#if (PHOTODIODE_EN != 0)
+typedef enum {
+    LED_REG_MODE_CURRENT = 0,
+    LED_REG_MODE_LIGHT,        // photodiode loop, the current loop is the inner one
+} led_reg_mode_t;
+#endif
+
+
 extern uint8_t led_current_pct;
+extern uint16_t led_current_ma;
+#if (PHOTODIODE_EN != 0)
+extern uint8_t led_reg_mode;      // led_reg_mode_t
+extern uint16_t led_light_max;    // uW/cm2 at led_current_pct 100, light mode
+#endif
 
 
 extern void led_driver_init(void);
 extern void led_driver_process(void);
+extern bool led_driver_calibr_import(void);
+extern void led_driver_set_gate(bool is_on);
+extern void led_driver_cutoff(void);
+#if (PHOTODIODE_EN != 0)
+extern void led_driver_params_save(void);
+#endif
 
 
 #endif   // _LED_DRIVER_H_
@@ -11,6 +11,21 @@
 #include "char1602.h"
 #include "led_driver.h"
 #include "menu.h"
+#include "fl_exposure.h"
+#if (PHOTODIODE_EN != 0)
+#include "photodiode.h"
+#endif
+#if (HEATER_EN != 0)
+#include "heater_driver.h"
+#include "fan_driver.h"
+#include "sensor_manager.h"
+#endif
+
+
+// 18 KB of flash without the heater, the ATmega8 branches of the drivers are kept for reference only
+#ifdef __AVR_ATmega8__
+#error "main: the firmware does not fit the ATmega8 flash, build for the ATmega328P (MCU_TARGET)"
+#endif
 
 
 
@@ -38,7 +53,15 @@ int main(void) {
     gpio_init();
     encoder_init();
     meas_init();
+    #if (PHOTODIODE_EN != 0)
+    photodiode_init();
+    #endif
     led_driver_init();
+    #if (HEATER_EN != 0)
+    sensor_manager_init();
+    heater_init();
+    fan_driver_init();
+    #endif
     lcd1602_init();
     menu_init();
     #if (CLI_ENABLED != 0)
@@ -64,6 +87,9 @@ int main(void) {
 
         is_meas_ready = meas_is_data_ready();
         if (is_meas_ready) {
+            #if (PHOTODIODE_EN != 0)
+            photodiode_process();
+            #endif
             led_driver_process();
             /*
             if (systimer_triggered_ms(device_state_timer)) {
@@ -90,6 +116,13 @@ int main(void) {
             */
         }
 
+        #if (HEATER_EN != 0)
+        sensor_manager_process();
+        heater_process();
+        fan_driver_process();
+        #endif
+
+        fl_exposure_process();
         menu_process();
     }
 
@@ -99,4 +132,8 @@ int main(void) {
 
 ISR(TIMER2_OVF_vect) {
     systimer_process_ms();
+    fl_exposure_cutoff_process();
+    #if (HEATER_EN != 0)
+    fan_driver_tach_process();
+    #endif
 }
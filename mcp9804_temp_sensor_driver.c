@@ -1,54 +1,214 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
 #include "mcp9804_temp_sensor_driver.h"
 #include "twi_driver.h"
+#include "sensor_manager.h"
+#include "gpio_driver.h"
+#include "eeprom_driver.h"
+#include "device_registers.h"
+#include "error_handler.h"
+#include "char1602.h"
 
 
-#define MCP9804_SLAVE_ADDR (0b01001000 << 1)
+#ifndef MCP9804_ADDR_PINS
+#define MCP9804_ADDR_PINS  (0)   // A2..A0
+#endif
+#define MCP9804_SLAVE_ADDR ((0b0011000 | MCP9804_ADDR_PINS) << 1)
 
-#define MCP9804_TEMPERATURE_REG (0x00)
 #define MCP9804_CONFIG_REG      (0x01)
-    #define MCP9804_CONFIG_REG_SD_POS  (0)  // Shutdown Mode
-    #define MCP9804_CONFIG_REG_TM_POS  (1)  // Thermostat Mode
-    #define MCP9804_CONFIG_REG_POL_POS (2)  // Polarity
-    #define MCP9804_CONFIG_REG_F0_POS  (3)  // Fault Queue
-    #define MCP9804_CONFIG_REG_R0_POS  (5)  // Converter Resolution
-    #define MCP9804_CONFIG_REG_OS_POS  (7)  // One-Shot
+    #define MCP9804_CONFIG_REG_ALERT_MOD_POS (0)   // 0 - comparator output
+    #define MCP9804_CONFIG_REG_ALERT_POL_POS (1)   // 0 - active low
+    #define MCP9804_CONFIG_REG_ALERT_SEL_POS (2)   // 0 - upper, lower and critical limits
+    #define MCP9804_CONFIG_REG_ALERT_CNT_POS (3)   // output enable
+    #define MCP9804_CONFIG_REG_HYST_POS      (9)   // 0 / 1.5 / 3 / 6 C
+#define MCP9804_T_UPPER_REG     (0x02)
+#define MCP9804_T_LOWER_REG     (0x03)
+#define MCP9804_T_CRIT_REG      (0x04)
+#define MCP9804_TEMPERATURE_REG (0x05)
+    #define MCP9804_TEMPERATURE_REG_CRIT_MSK  (1 << 7)   // high byte flags
+    #define MCP9804_TEMPERATURE_REG_UPPER_MSK (1 << 6)
+#define MCP9804_RESOLUTION_REG  (0x08)
+    #define MCP9804_RESOLUTION_0_0625C (3)
 
+#define MCP9804_CONV_TIME_MS    (250)   // 0.0625 C resolution, 30 / 65 / 130 / 250 ms for 0.5 / 0.25 / 0.125 / 0.0625 C
+#define MCP9804_TWI_TIMEOUT_MS  (20)
 
-static uint8_t mcp9804_tx_data_buff[3];
+#define MCP9804_T_UPPER_DEF_C   (60)
+#define MCP9804_T_CRIT_DEF_C    (80)
+#define MCP9804_T_LOWER_C       (-40)   // lower limit is not used
+#define MCP9804_HYST            (2)     // 3 C
+
+#define MCP9804_ALERT_GPIOD_PIN  (2)   // INT0
+#define MCP9804_ALERT_PIN_STATE  (GPIOD_GET(MCP9804_ALERT_GPIOD_PIN))
+#define MCP9804_ALERT_PULL_UP_EN (GPIOD_SET(MCP9804_ALERT_GPIOD_PIN))
+
+// The LCD drives RW as an output, the pull-up and the edge interrupt would fight it
+#if (MCP9804_ALERT_INT_EN != 0) && (MCP9804_ALERT_GPIOD_PIN == LCD1602_RW_GPIOD_PIN)
+#error "mcp9804: ALERT (INT0 / PD2) is LCD RW on this board, build with MCP9804_ALERT_INT_EN = 0"
+#endif
+
+
+uint16_t mcp9804_t_upper_c;
+uint16_t mcp9804_t_crit_c;
+
+static uint8_t mcp9804_tx_data_buff[2];
+static uint8_t mcp9804_config_data_buff[3];
 static uint8_t mcp9804_rx_data_buff[2];
-static twi_driver_msg_t mcp9804_twi_driver_msg;
+static twi_driver_msg_t mcp9804_config_twi_driver_msg;
+static uint8_t mcp9804_config_step;
+static sensor_manager_sensor_t mcp9804_sensor;
+static volatile bool is_mcp9804_alert;
+
+
+
+
+static void mcp9804_temp_sensor_config_next(twi_driver_msg_t *twi_driver_msg);
+static uint16_t mcp9804_temp_sensor_limit(int16_t temperature_c);
+static bool mcp9804_temp_sensor_parse(uint8_t *rx_data, uint16_t *temperature_c);
 
 
 
 
 void mcp9804_temp_sensor_driver_init(void) {
-    twi_driver_init();
+    eeprom_driver_read_16(EE_ADDR_BOARD_T_UPPER_C, &mcp9804_t_upper_c);
+    eeprom_driver_read_16(EE_ADDR_BOARD_T_CRIT_C, &mcp9804_t_crit_c);
+    if ((mcp9804_t_crit_c == 0) || (mcp9804_t_crit_c > 125)) mcp9804_t_crit_c = MCP9804_T_CRIT_DEF_C;
+    if ((mcp9804_t_upper_c == 0) || (mcp9804_t_upper_c >= mcp9804_t_crit_c)) mcp9804_t_upper_c = MCP9804_T_UPPER_DEF_C;
+    if (mcp9804_t_upper_c >= mcp9804_t_crit_c) mcp9804_t_upper_c = mcp9804_t_crit_c - 1;
 
-    mcp9804_twi_driver_msg.slave_addr = MCP9804_SLAVE_ADDR;
-    mcp9804_twi_driver_msg.timeout_ms = 1000;
-    mcp9804_twi_driver_msg.tx_data = mcp9804_tx_data_buff;
-    mcp9804_twi_driver_msg.rx_data = mcp9804_rx_data_buff;
+    is_mcp9804_alert = false;
 
+    // Resolution, limits and ALERT output, one register per transaction from the TWI callback
+    mcp9804_config_twi_driver_msg.slave_addr = MCP9804_SLAVE_ADDR;
+    mcp9804_config_twi_driver_msg.timeout_ms = MCP9804_TWI_TIMEOUT_MS;
+    mcp9804_config_twi_driver_msg.tx_data = mcp9804_config_data_buff;
+    mcp9804_config_twi_driver_msg.rx_data_max_qty = 0;
+    mcp9804_config_twi_driver_msg.callback = mcp9804_temp_sensor_config_next;
+    mcp9804_config_step = 0;
+    mcp9804_temp_sensor_config_next(&mcp9804_config_twi_driver_msg);
+
+    // Temperature read, polled by the sensor manager, the first result is ready one conversion time later
+    mcp9804_tx_data_buff[0] = MCP9804_TEMPERATURE_REG;
+    mcp9804_sensor.msg.slave_addr = MCP9804_SLAVE_ADDR;
+    mcp9804_sensor.msg.timeout_ms = MCP9804_TWI_TIMEOUT_MS;
+    mcp9804_sensor.msg.tx_data = mcp9804_tx_data_buff;
+    mcp9804_sensor.msg.tx_data_qty = 1;
+    mcp9804_sensor.msg.rx_data = mcp9804_rx_data_buff;
+    mcp9804_sensor.msg.rx_data_max_qty = 2;
+    mcp9804_sensor.period_ms = MCP9804_CONV_TIME_MS;
+    mcp9804_sensor.parse = mcp9804_temp_sensor_parse;
+    sensor_manager_register(&mcp9804_sensor, MCP9804_CONV_TIME_MS);
 
-    mcp9804_twi_driver_msg.tx_data_qty = 3;
-    mcp9804_tx_data_buff[0] = MCP9804_CONFIG_REG;
-    mcp9804_tx_data_buff[1] = 0;
-    mcp9804_tx_data_buff[2] = 4 << MCP9804_CONFIG_REG_R0_POS;  // 12bit(0.0625)
-    mcp9804_twi_driver_msg.rx_data_max_qty = 0;
-    twi_driver_transmit(&mcp9804_twi_driver_msg);
+    #if (MCP9804_ALERT_INT_EN != 0)
+    MCP9804_ALERT_PULL_UP_EN;
+    is_mcp9804_alert = ((MCP9804_ALERT_PIN_STATE) == 0);
+    #ifdef __AVR_ATmega8__
+    MCUCR |= (0b01 << ISC00);   // INT0 Sense Control: any logical change
+    GICR |= (1 << INT0);
+    #else
+    EICRA |= (0b01 << ISC00);
+    EIMSK |= (1 << INT0);
+    #endif
+    #endif
 }
 
 
+// temperature_c - 1/16 C, cached reading of the sensor manager, never waits for the bus
 bool mcp9804_temp_sensor_get_temp(uint16_t *temperature_c) {
-    mcp9804_twi_driver_msg.tx_data_qty = 1;
-    mcp9804_tx_data_buff[0] = MCP9804_TEMPERATURE_REG;
-    mcp9804_twi_driver_msg.rx_data_max_qty = 2;
-    if (twi_driver_transmit(&mcp9804_twi_driver_msg) != TWI_DRIVER_RESULT_OK) return 1;
-
-    *temperature_c = mcp9804_rx_data_buff[0];
-    *temperature_c = *temperature_c << 4;
-    *temperature_c |= mcp9804_rx_data_buff[1] >> 4;
+    if (!sensor_manager_get(&mcp9804_sensor, temperature_c)) return 1;
     return 0;
 }
+
+
+// Board temperature is above mcp9804_t_upper_c (comparator output, MCP9804_HYST)
+bool mcp9804_temp_sensor_is_alert(void) {
+    return is_mcp9804_alert;
+}
+
+
+
+
+static void mcp9804_temp_sensor_config_next(twi_driver_msg_t *twi_driver_msg) {
+    uint8_t reg;
+    uint16_t data;
+
+
+    switch (mcp9804_config_step) {
+        case 0:
+            reg = MCP9804_RESOLUTION_REG;
+            data = MCP9804_RESOLUTION_0_0625C;
+            break;
+
+        case 1:
+            reg = MCP9804_T_UPPER_REG;
+            data = mcp9804_temp_sensor_limit(mcp9804_t_upper_c);
+            break;
+
+        case 2:
+            reg = MCP9804_T_LOWER_REG;
+            data = mcp9804_temp_sensor_limit(MCP9804_T_LOWER_C);
+            break;
+
+        case 3:
+            reg = MCP9804_T_CRIT_REG;
+            data = mcp9804_temp_sensor_limit(mcp9804_t_crit_c);
+            break;
+
+        case 4:
+            reg = MCP9804_CONFIG_REG;
+            data = (MCP9804_HYST << MCP9804_CONFIG_REG_HYST_POS) | (MCP9804_ALERT_INT_EN << MCP9804_CONFIG_REG_ALERT_CNT_POS);
+            break;
+
+        default:
+            return;
+    }
+    mcp9804_config_step++;
+
+    mcp9804_config_data_buff[0] = reg;
+    if (reg == MCP9804_RESOLUTION_REG) {
+        mcp9804_config_data_buff[1] = data;
+        twi_driver_msg->tx_data_qty = 2;
+    }
+    else {
+        mcp9804_config_data_buff[1] = data >> 8;
+        mcp9804_config_data_buff[2] = data;
+        twi_driver_msg->tx_data_qty = 3;
+    }
+    twi_driver_submit(twi_driver_msg);
+}
+
+
+// Limit registers: [12] - sign, [11:2] - temperature, 0.25 C
+static uint16_t mcp9804_temp_sensor_limit(int16_t temperature_c) {
+    return ((uint16_t)(temperature_c * 16)) & 0x1FFC;
+}
+
+
+static bool mcp9804_temp_sensor_parse(uint8_t *rx_data, uint16_t *temperature_c) {
+    // T_A register: [15:13] - alert flags (crit, upper, lower), [12] - sign, [11:0] - temperature, 1/16 C
+    if (rx_data[0] & MCP9804_TEMPERATURE_REG_CRIT_MSK) eh_state |= EH_STATUS_FLAG_BOARD_OVERTEMP_ERR;
+    #if (MCP9804_ALERT_INT_EN == 0)
+    is_mcp9804_alert = ((rx_data[0] & (MCP9804_TEMPERATURE_REG_CRIT_MSK | MCP9804_TEMPERATURE_REG_UPPER_MSK)) != 0);
+    #endif
+
+    if (rx_data[0] & 0x10) {
+        *temperature_c = 0;   // below 0 C
+    }
+    else {
+        *temperature_c = rx_data[0] & 0x0F;
+        *temperature_c = *temperature_c << 8;
+        *temperature_c |= rx_data[1];
+    }
+    return true;
+}
+
+
+
+
+#if (MCP9804_ALERT_INT_EN != 0)
+ISR(INT0_vect) {
+    is_mcp9804_alert = ((MCP9804_ALERT_PIN_STATE) == 0);
+}
+#endif
@@ -5,7 +5,19 @@
 #define MCP9804_TEMP_SENSOR_DRIVER_H
 
 
+// ALERT output (open drain, active low) on INT0 / PD2, which is LCD RW on the current board.
+// 0 - alert state is taken from the T_A flags of every poll, 1 is refused while PD2 is LCD RW
+#ifndef MCP9804_ALERT_INT_EN
+#define MCP9804_ALERT_INT_EN (0)
+#endif
+
+
+extern uint16_t mcp9804_t_upper_c;   // board alert limit, outputs are throttled above it
+extern uint16_t mcp9804_t_crit_c;    // board critical limit, EH_STATUS_FLAG_BOARD_OVERTEMP_ERR
+
+
 extern void mcp9804_temp_sensor_driver_init(void);
 extern bool mcp9804_temp_sensor_get_temp(uint16_t *temperature);
+extern bool mcp9804_temp_sensor_is_alert(void);
 
 #endif   // MCP9804_TEMP_SENSOR_DRIVER_H
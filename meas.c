@@ -32,8 +32,15 @@
                          (4 << ADPS0))
 #endif
 
-#define MEAS_CHANNELS_QTY (2)
+#if (HEATER_EN != 0) && (HEATER_QTY > 1)
+static const uint8_t meas_adc_channels[MEAS_CHANNELS_QTY] = {0, 7, 6, HEATER_1_ADC_CH};   // led_voltage, led_current, heater_tc, heater_1_tc
+#elif (HEATER_EN != 0)
+static const uint8_t meas_adc_channels[MEAS_CHANNELS_QTY] = {0, 7, 6};   // led_voltage, led_current, heater_tc
+#elif (PHOTODIODE_EN != 0)
+static const uint8_t meas_adc_channels[MEAS_CHANNELS_QTY] = {0, 7, PHOTODIODE_ADC_CH};   // led_voltage, led_current, photodiode
+#else
 static const uint8_t meas_adc_channels[MEAS_CHANNELS_QTY] = {0, 7};   // led_voltage, led_current
+#endif
 static uint8_t meas_channels_cnt;
 static bool is_data_ready;
 ///tatic uint8_t meas_skip_cnt;
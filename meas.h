@@ -9,13 +9,46 @@
 #define ADC_REF_MV   (2510)
 #define ADC_MAX_CODE (1024)
 
+// channel_index of the heater thermocouples
+#define MEAS_CH_HEATER_TC   (2)
+#define MEAS_CH_HEATER_1_TC (3)
+#ifndef HEATER_1_ADC_CH
+#define HEATER_1_ADC_CH     (5)   // PC5, shared with the LCD on the current board
+#endif
+
+#ifndef PHOTODIODE_ADC_CH
+#define PHOTODIODE_ADC_CH   (6)   // ADC6, the heater thermocouple input in the heater build
+#endif
+#if (PHOTODIODE_EN != 0) && (HEATER_EN != 0)
+#error "meas: photodiode is supported in the heater-less build only"
+#endif
+
+#if (HEATER_EN != 0) && (HEATER_QTY > 1)
+#define MEAS_CHANNELS_QTY (4)
+#elif (HEATER_EN != 0)
+#define MEAS_CHANNELS_QTY (3)
+#elif (PHOTODIODE_EN != 0)
+#define MEAS_CHANNELS_QTY (3)
+#else
+#define MEAS_CHANNELS_QTY (2)
+#endif
+
 
 typedef union {
     struct {
         uint16_t led_voltage;
         uint16_t led_current;
+        #if (HEATER_EN != 0)
+        uint16_t heater_tc;
+        #endif
+        #if (HEATER_EN != 0) && (HEATER_QTY > 1)
+        uint16_t heater_1_tc;
+        #endif
+        #if (PHOTODIODE_EN != 0)
+        uint16_t photodiode;
+        #endif
     } channel_name;
-    uint16_t channel_index[2];
+    uint16_t channel_index[MEAS_CHANNELS_QTY];
 } meas_adc_data_t;
 
 extern meas_adc_data_t meas_adc_data;
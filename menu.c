@@ -7,25 +7,17 @@
 #include "systimer.h"
 #include "char1602.h"
 #include "gpio_driver.h"
-#include "eeprom_driver.h"
+#include "fl_profile_store.h"
+#include "fl_exposure.h"
 #include "error_handler.h"
+#include "eeprom_partitions.h"
 
 
-#define EEPROM_FIRST_FL_PROFILE_ADDR     (0x0080)
-#define EEPROM_FL_PROFILE_NAME_OFFSET    (0)
-#define EEPROM_FL_PROFILE_NAME_SIZE      (14)
-#define EEPROM_FL_PROFILE_CURRENT_OFFSET (EEPROM_FL_PROFILE_NAME_OFFSET + EEPROM_FL_PROFILE_NAME_SIZE)
-#define EEPROM_FL_PROFILE_CURRENT_SIZE   (2)
-#define EEPROM_FL_PROFILE_TIME_OFFSET    (EEPROM_FL_PROFILE_CURRENT_OFFSET + EEPROM_FL_PROFILE_CURRENT_SIZE)
-#define EEPROM_FL_PROFILE_TIME_SIZE      (2)
-#define EEPROM_FL_PROFILE_SIZE           (EEPROM_FL_PROFILE_NAME_SIZE + EEPROM_FL_PROFILE_CURRENT_SIZE + EEPROM_FL_PROFILE_TIME_SIZE)
-
-
-#define STATUS_LED_EN  (GPIOB_SET(3))
-#define STATUS_LED_DIS (GPIOB_RESET(3))
+#define STATUS_LED_EN  (GPIOB_SET(GPIOB_STATUS_LED_PIN))
+#define STATUS_LED_DIS (GPIOB_RESET(GPIOB_STATUS_LED_PIN))
 #define BUZZER_EN      (GPIOD_SET(7))
 #define BUZZER_DIS     (GPIOD_RESET(7))
-#define TAMPER_PIN     (GPIOB_GET(0))
+#define TAMPER_PIN     (GPIOB_GET(GPIOB_TAMPER_PIN))
 
 
 typedef enum {
@@ -63,7 +55,7 @@ static tamper_process_state_t tamper_process_state;
 static timer_t tamper_process_timer;
 static bool tamper_is_pressed = false;
 
-uint32_t eeprom_fl_profiles_qty;
+static fl_profile_t fl_profile;   // shown store entry or the running program
 
 
 
@@ -80,8 +72,10 @@ static void buzzer_dis(void);
 
 static void tamper_process(void);
 
-static void get_fl_profile_name_from_eeprom(uint8_t profile_index, uint8_t *name);
-static void get_fl_profile_param_from_eeprom(uint8_t profile_index, uint16_t *current_pct, uint16_t *time_s);
+static void fl_process_load_const(uint16_t current_pct, uint16_t time_s);
+static void fl_process_print_time(void);
+static void fl_process_print_ms(uint32_t time_ms);
+
 static void change_var_value(uint16_t *var, int8_t delta, uint16_t max_var_value);
 static void dig_to_string(uint16_t digit, uint8_t *string);
 
@@ -89,26 +83,7 @@ static void dig_to_string(uint16_t digit, uint8_t *string);
 
 
 void menu_init(void) {
-    uint8_t i, y;
-    bool is_correct_profile;
-    uint16_t current_pct, time_s;
-    uint8_t empty_simw_cnt;
-
-
-    // Check profiles in EEPROM
-    for (i = 0; i <= 7; i++) {
-        is_correct_profile = true;
-        get_fl_profile_name_from_eeprom(i, lcd_string);
-        empty_simw_cnt = 0;
-        for (y = 0; y <= 14; y++) {
-            if ((lcd_string[y] == ' ') || (lcd_string[y] == 0xFF)) empty_simw_cnt++;
-        }
-        if (empty_simw_cnt == 14) is_correct_profile = false;
-        get_fl_profile_param_from_eeprom(i, &current_pct, &time_s);
-        if (current_pct > 100) is_correct_profile = false;
-        if (time_s < 1) is_correct_profile = false;
-        if (is_correct_profile) eeprom_fl_profiles_qty++;
-    }
+    fl_profile_store_init();
 
     lcd1602_clear();
     lcd1602_move_coursor(6, 0);
@@ -124,11 +99,11 @@ void menu_process(void) {
     int8_t encoder_step;
     static uint16_t setup_led_current_pct;
     static uint16_t setup_fl_process_time_s;
-    static uint16_t fl_process_time_s;
     static bool is_state_init;
-    uint16_t minutes, seconds;
     static uint8_t current_test_time_point, test_time_points_qty;
     static uint16_t test_time_points[6];
+    uint8_t fl_profiles_qty;
+    uint8_t i;
 
 
     status_led_process();
@@ -136,7 +111,7 @@ void menu_process(void) {
     tamper_process();
 
 
-    if ((eh_state != 0) && (menu_state != MENU_STATE_INTRO)) {
+    if (((eh_state & ~EH_STATUS_HEATER_ONLY_MSK) != 0) && (menu_state != MENU_STATE_INTRO)) {
         is_state_init = true;
         menu_state = MENU_STATE_FATAL_ERROR;
     }
@@ -153,6 +128,10 @@ void menu_process(void) {
 
 
         case MENU_STATE_FL_PROFILES_MENU:
+            // Entries can be added or deleted from the CLI at any time
+            fl_profiles_qty = fl_profile_store_qty();
+            if (fl_profilse_index > (fl_profiles_qty + 2)) fl_profilse_index = fl_profiles_qty + 2;
+
             if (is_state_init) {
                 encoder_clear_all_events();
                 lcd1602_move_coursor(0, 0);
@@ -163,7 +142,7 @@ void menu_process(void) {
             if ((encoder_step != 0) || is_state_init) {
                 is_state_init = false;
 
-                if ((encoder_step > 0) && (fl_profilse_index < (eeprom_fl_profiles_qty + 2))) {
+                if ((encoder_step > 0) && (fl_profilse_index < (fl_profiles_qty + 2))) {
                     fl_profilse_index++;
                 }
                 if ((encoder_step < 0) && (fl_profilse_index > 0)) {
@@ -178,47 +157,57 @@ void menu_process(void) {
                     lcd1602_print_char(0x7E);   // ->
                 }
                 // Custom - constant profile
-                else if (fl_profilse_index == (eeprom_fl_profiles_qty + 1)) {
+                else if (fl_profilse_index == (fl_profiles_qty + 1)) {
                     lcd1602_print_str("Custom        ");
                     lcd1602_print_char(0x7F);   // <-
                     lcd1602_print_char(0x7E);   // ->
                 }
                 // Test - constant profile
-                else if (fl_profilse_index == (eeprom_fl_profiles_qty + 2)) {
+                else if (fl_profilse_index == (fl_profiles_qty + 2)) {
                     lcd1602_print_str("Test          ");
                     lcd1602_print_char(0x7F);   // <-
                     lcd1602_print_char(' ');
                 }
                 // EEPROM profiles
                 else {
-                    get_fl_profile_name_from_eeprom((fl_profilse_index - 1), lcd_string);
-                    lcd1602_print_str((char*)lcd_string);
+                    // Loaded on scroll, one entry at a time
+                    if (fl_profile_store_read((fl_profilse_index - 1), &fl_profile)) {
+                        for (i = 0; i < FL_PROFILE_NAME_SIZE; i++) lcd_string[i] = (fl_profile.name[i] == 0xFF) ? ' ' : fl_profile.name[i];
+                        lcd_string[FL_PROFILE_NAME_SIZE] = '\0';
+                        lcd1602_print_str((char*)lcd_string);
+                    }
+                    else {
+                        lcd1602_print_str("Broken profile");
+                    }
                     lcd1602_print_char(0x7F);   // <-
                     lcd1602_print_char(0x7E);   // ->
                 }
             }
 
             if (encoder_is_press_event()) {
-                fl_process_time_s = 0;
+                // Broken entry is not started
+                if ((fl_profilse_index > 0) && (fl_profilse_index <= fl_profiles_qty) &&
+                    !fl_profile_store_read((fl_profilse_index - 1), &fl_profile)) {
+                    break;
+                }
                 fl_process_is_test = false;
                 is_state_init = true;
                 menu_state = MENU_STATE_FL_PROCESS_PAUSE;
                 // Tanning - constant profile
                 if (fl_profilse_index == 0) {
-                    setup_led_current_pct = 60;
-                    setup_fl_process_time_s = 10 * 60;
+                    fl_process_load_const(60, 10 * 60);
                 }
                 // Custom - constant profile
-                else if (fl_profilse_index == (eeprom_fl_profiles_qty + 1)) {
+                else if (fl_profilse_index == (fl_profiles_qty + 1)) {
                     menu_state = MENU_STATE_CUSTOM_CURR_SETUP_MENU;
                 }
                 // Test - constant profile
-                else if (fl_profilse_index == (eeprom_fl_profiles_qty + 2)) {
+                else if (fl_profilse_index == (fl_profiles_qty + 2)) {
                     menu_state = MENU_STATE_TEST_CURR_SETUP_MENU;
                 }
                 // EEPROM profiles
                 else {
-                    get_fl_profile_param_from_eeprom((fl_profilse_index - 1), &setup_led_current_pct, &setup_fl_process_time_s);
+                    fl_exposure_load(&fl_profile);
                 }
             }
             break;
@@ -278,7 +267,7 @@ void menu_process(void) {
                     menu_state = MENU_STATE_FL_PROFILES_MENU;
                 }
                 else if (encoder_is_press_event()) {
-                    fl_process_time_s = 0;
+                    fl_process_load_const(setup_led_current_pct, setup_fl_process_time_s);
                     fl_process_is_test = false;
                     is_state_init = true;
                     menu_state = MENU_STATE_FL_PROCESS_PAUSE;
@@ -353,8 +342,7 @@ void menu_process(void) {
                     if ((test_time_points[current_test_time_point] == 0) || (current_test_time_point >= 6)) {
                         if (test_time_points[current_test_time_point] > 0) test_time_points_qty++;
                         current_test_time_point = 0;
-                        setup_fl_process_time_s = test_time_points[0];
-                        fl_process_time_s = 0;
+                        fl_process_load_const(setup_led_current_pct, test_time_points[0]);
                         fl_process_is_test = true;
                         is_state_init = true;
                         menu_state = MENU_STATE_FL_PROCESS_PAUSE;
@@ -390,29 +378,11 @@ void menu_process(void) {
                         lcd1602_print_str("Fl process      ");
                     }
 
-                    lcd1602_move_coursor(0, 1);
-                    minutes = fl_process_time_s / 60;
-                    seconds = minutes * 60;
-                    seconds = fl_process_time_s - seconds;
-                    dig_to_string(minutes, lcd_string);
-                    lcd1602_print_str((char*)&lcd_string[2]);
-                    lcd1602_print_char('m');
-                    dig_to_string(seconds, lcd_string);
-                    lcd1602_print_str((char*)&lcd_string[3]);
-                    lcd1602_print_str("s/");
-
-                    minutes = setup_fl_process_time_s / 60;
-                    seconds = minutes * 60;
-                    seconds = setup_fl_process_time_s - seconds;
-                    dig_to_string(minutes, lcd_string);
-                    lcd1602_print_str((char*)&lcd_string[2]);
-                    lcd1602_print_char('m');
-                    dig_to_string(seconds, lcd_string);
-                    lcd1602_print_str((char*)&lcd_string[3]);
-                    lcd1602_print_char('s');
+                    fl_process_print_time();
                 }
 
                 if (encoder_is_long_press_event()) {
+                    fl_exposure_abort();
                     is_state_init = true;
                     menu_state = MENU_STATE_FL_PROFILES_MENU;
                 }
@@ -441,33 +411,33 @@ void menu_process(void) {
                     is_state_init = false;
                     encoder_clear_all_events();
 
-                    ////db
-                    lcd1602_move_coursor(0, 1);
-                    lcd1602_print_str("Process         ");
-
-                    menu_timer = systimer_set_ms(1000);
-                    ////dbg led_current_pct = setup_led_current_pct;
+                    fl_exposure_run();
+                    menu_timer = systimer_set_ms(0);
                     status_led_const_en();
                     buzzer_single_beep();
                 }
 
                 if (!tamper_is_pressed) {
-                    led_current_pct = 0;
+                    fl_exposure_pause();
                     status_led_dis();
                     buzzer_single_beep();
                     is_state_init = true;
                     menu_state = MENU_STATE_FL_PROCESS_PAUSE;
                 }
+                else if (fl_exposure_state == FL_EXPOSURE_STATE_DONE) {
+                    is_state_init = true;
+                    menu_state = MENU_STATE_FL_PROCESS_DONE;
+                }
+                // Progress: segment and time, once a second
                 else if (systimer_triggered_ms(menu_timer)) {
-                    fl_process_time_s++;
-                    if (fl_process_time_s >= setup_fl_process_time_s) {
-                        led_current_pct = 0;
-                        is_state_init = true;
-                        menu_state = MENU_STATE_FL_PROCESS_DONE;
-                    }
-                    else {
-                        menu_timer = systimer_set_ms(1000);
+                    menu_timer += 1000;
+                    if (!fl_process_is_test && (fl_exposure_segments_qty > 1)) {
+                        lcd1602_move_coursor(11, 0);
+                        lcd1602_print_char('1' + fl_exposure_segment);
+                        lcd1602_print_char('/');
+                        lcd1602_print_char('0' + fl_exposure_segments_qty);
                     }
+                    fl_process_print_time();
                 }
                 break;
 
@@ -498,8 +468,7 @@ void menu_process(void) {
                             menu_state = MENU_STATE_FL_PROFILES_MENU;
                         }
                         else {
-                            fl_process_time_s = 0;
-                            setup_fl_process_time_s = test_time_points[current_test_time_point];
+                            fl_process_load_const(setup_led_current_pct, test_time_points[current_test_time_point]);
                             menu_state = MENU_STATE_FL_PROCESS_PAUSE;
                         }
                     }
@@ -513,13 +482,23 @@ void menu_process(void) {
             case MENU_STATE_FATAL_ERROR:
                 if (is_state_init) {
                     is_state_init = false;
+                    fl_exposure_abort();
                     lcd1602_clear();
                     lcd1602_move_coursor(0, 0);
                     lcd1602_print_str("Fatal error!");
                     lcd1602_move_coursor(0, 1);
                     if (eh_state & EH_STATUS_FLAG_FW_ERR) lcd1602_print_str("FW ");
                     if (eh_state & EH_STATUS_FLAG_LCD_DCDC_OVERVOLTAGE_ERR) lcd1602_print_str("OVRV ");
-                    if (eh_state & EH_STATUS_FLAG_LCD_DCDC_OVERCURRENT_ERR) lcd1602_print_str("OVRC");
+                    if (eh_state & EH_STATUS_FLAG_LCD_DCDC_OVERCURRENT_ERR) lcd1602_print_str("OVRC ");
+                    #if (HEATER_EN != 0)
+                    if (eh_state & EH_STATUS_FLAG_CAL_ERR) lcd1602_print_str("CAL ");
+                    if (eh_state & EH_STATUS_FLAG_HEATER_ERR) lcd1602_print_str("HT ");
+                    if (eh_state & EH_STATUS_FLAG_HEATER_RUNAWAY_ERR) lcd1602_print_str("RUN ");
+                    if (eh_state & EH_STATUS_FLAG_HEATER_TC_OPEN_ERR) lcd1602_print_str("TCO ");
+                    if (eh_state & EH_STATUS_FLAG_HEATER_TC_SHORT_ERR) lcd1602_print_str("TCS ");
+                    if (eh_state & EH_STATUS_FLAG_FAN_ERR) lcd1602_print_str("FAN ");
+                    if (eh_state & EH_STATUS_FLAG_BOARD_OVERTEMP_ERR) lcd1602_print_str("BRD");
+                    #endif
                 }
                 break;
 
@@ -649,29 +628,50 @@ static void tamper_process(void) {
 }
 
 
-static void get_fl_profile_name_from_eeprom(uint8_t profile_index, uint8_t *name) {
-    uint16_t addr;
+// Single segment program for Tanning, Custom and Test runs
+static void fl_process_load_const(uint16_t current_pct, uint16_t time_s) {
+    fl_profile.current_pct = current_pct;
+    fl_profile.time_s = time_s;
+    fl_profile.segments_qty = 0;
+    fl_profile.dose_target = 0;
+    fl_exposure_load(&fl_profile);
+}
+
+
+// Second line: elapsed/total, "mmmMssS/mmmMssS". Dose program: "DosepppP mmmMssS" - dose %, elapsed.
+static void fl_process_print_time(void) {
+    uint32_t dose_pct;
 
 
-    addr = EEPROM_FL_PROFILE_SIZE;
-    addr = addr * profile_index;
-    addr += EEPROM_FIRST_FL_PROFILE_ADDR + EEPROM_FL_PROFILE_NAME_OFFSET;
-    eeprom_driver_read(addr, EEPROM_FL_PROFILE_NAME_SIZE, name);
-    name[14] = '\0';
+    lcd1602_move_coursor(0, 1);
+    if (fl_exposure_dose_target != 0) {
+        dose_pct = ((uint32_t)fl_exposure_dose * 100) / fl_exposure_dose_target;
+        lcd1602_print_str("Dose");
+        dig_to_string(((dose_pct > 999) ? 999 : dose_pct), lcd_string);
+        lcd1602_print_str((char*)&lcd_string[2]);
+        lcd1602_print_str("% ");
+        fl_process_print_ms(fl_exposure_get_elapsed_ms());
+    }
+    else {
+        fl_process_print_ms(fl_exposure_get_elapsed_ms());
+        lcd1602_print_char('/');
+        fl_process_print_ms(fl_exposure_total_ms);
+    }
 }
 
 
-static void get_fl_profile_param_from_eeprom(uint8_t profile_index, uint16_t *current_pct, uint16_t *time_s) {
-    uint16_t addr_b, addr;
+// "mmmMssS"
+static void fl_process_print_ms(uint32_t time_ms) {
+    uint32_t time_s;
 
 
-    addr_b = EEPROM_FL_PROFILE_SIZE;
-    addr_b = addr_b * profile_index;
-    addr_b += EEPROM_FIRST_FL_PROFILE_ADDR;
-    addr = addr_b + EEPROM_FL_PROFILE_CURRENT_OFFSET;
-    eeprom_driver_read_16(addr, current_pct);
-    addr = addr_b + EEPROM_FL_PROFILE_TIME_OFFSET;
-    eeprom_driver_read_16(addr, time_s);
+    time_s = time_ms / 1000;
+    dig_to_string((((time_s / 60) > 999) ? 999 : (time_s / 60)), lcd_string);
+    lcd1602_print_str((char*)&lcd_string[2]);
+    lcd1602_print_char('m');
+    dig_to_string((time_s % 60), lcd_string);
+    lcd1602_print_str((char*)&lcd_string[3]);
+    lcd1602_print_char('s');
 }
 
 
@@ -0,0 +1,44 @@
+#include "photodiode.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "meas.h"
+#include "calibr.h"
+#include "eeprom_record.h"
+#include "device_registers.h"
+
+
+uint16_t photodiode_irradiance;
+bool photodiode_is_calibr;
+
+static calibr_t photodiode_calibr;   // raw -> uW/cm2
+static eeprom_record_t photodiode_calibr_rec;
+
+
+
+
+// There is no nominal conversion, light is not used until the calibration is imported
+void photodiode_init(void) {
+    eeprom_record_init(&photodiode_calibr_rec, EE_PART_CALIBR_PHOTODIODE_ADDR, CALIBR_RECORD_SIZE, EE_REC_CALIBR_VERSION);
+    photodiode_is_calibr = calibr_load(&photodiode_calibr, &photodiode_calibr_rec) && calibr_update(&photodiode_calibr);
+    photodiode_irradiance = 0;
+}
+
+
+// Called once per ADC sweep, before led_driver_process()
+void photodiode_process(void) {
+    if (!photodiode_is_calibr) return;
+    photodiode_irradiance = calibr_calc(&photodiode_calibr, meas_adc_data.channel_name.photodiode);
+}
+
+
+// Raw points (raw code, uW/cm2 by a reference meter) written over the CLI to EE_PART_CALIBR_LED_RAW
+bool photodiode_calibr_import(void) {
+    calibr_t calibr;
+
+
+    if (!calibr_load_raw(&calibr, EE_PART_CALIBR_LED_RAW_ADDR) || !calibr_update(&calibr)) return false;
+    photodiode_calibr = calibr;
+    calibr_save(&photodiode_calibr, &photodiode_calibr_rec);
+    photodiode_is_calibr = true;
+    return true;
+}
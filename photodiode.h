@@ -0,0 +1,17 @@
+#ifndef _PHOTODIODE_H_
+#define _PHOTODIODE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+extern uint16_t photodiode_irradiance;   // uW/cm2, 0 without calibration
+extern bool photodiode_is_calibr;
+
+
+extern void photodiode_init(void);
+extern void photodiode_process(void);
+extern bool photodiode_calibr_import(void);
+
+
+#endif   // _PHOTODIODE_H_
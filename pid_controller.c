@@ -0,0 +1,64 @@
+#include "pid_controller.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+
+void pid_controller_init(pid_controller_t *pid, uint16_t kp, uint16_t ki, uint16_t kd, uint16_t kaw, uint16_t out_max) {
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->kaw = kaw;
+    pid->out_max = out_max;
+    pid_controller_reset(pid);
+}
+
+
+void pid_controller_reset(pid_controller_t *pid) {
+    pid->integrator = 0;
+    pid->d_filtered = 0;
+    pid->meas_prev = 0;
+    pid->is_first_call = true;
+}
+
+
+// Must be called with a fixed period, Ki and Kd are scaled to it
+uint16_t pid_controller_process(pid_controller_t *pid, int16_t setpoint, int16_t meas, uint16_t feed_forward) {
+    int16_t error;
+    int32_t out_max;
+    int32_t p_term;
+    int32_t d_raw;
+    int32_t out, out_sat;
+
+
+    if (pid->is_first_call) {
+        pid->meas_prev = meas;
+        pid->is_first_call = false;
+    }
+
+    out_max = (int32_t)pid->out_max << PID_CONTROLLER_GAIN_SHIFT;
+    error = setpoint - meas;
+
+    p_term = (int32_t)error * pid->kp;
+
+    // Derivative on measurement (no kick on setpoint change) + first order low-pass filter
+    d_raw = (int32_t)(pid->meas_prev - meas) * pid->kd;
+    pid->meas_prev = meas;
+    pid->d_filtered += (d_raw - pid->d_filtered) >> PID_CONTROLLER_D_FILTER_SHIFT;
+
+    // Integrator with clamping
+    pid->integrator += (int32_t)error * pid->ki;
+    if (pid->integrator > out_max) pid->integrator = out_max;
+    if (pid->integrator < -out_max) pid->integrator = -out_max;
+
+    out = p_term + pid->integrator + pid->d_filtered + ((int32_t)feed_forward << PID_CONTROLLER_GAIN_SHIFT);
+    out_sat = out;
+    if (out_sat > out_max) out_sat = out_max;
+    if (out_sat < 0) out_sat = 0;
+
+    // Back-calculation anti-windup: bleed the integrator by the saturation excess
+    pid->integrator += ((out_sat - out) >> PID_CONTROLLER_GAIN_SHIFT) * pid->kaw;
+
+    return (uint16_t)(out_sat >> PID_CONTROLLER_GAIN_SHIFT);
+}
@@ -0,0 +1,32 @@
+#ifndef _PID_CONTROLLER_H_
+#define _PID_CONTROLLER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Gains are fixed-point Q4 (1/16): output units per input unit (per control tick for Ki)
+#define PID_CONTROLLER_GAIN_SHIFT     (4)
+// Derivative low-pass filter: d = d + (d_raw - d) / 2^N
+#define PID_CONTROLLER_D_FILTER_SHIFT (2)
+
+
+typedef struct {
+    uint16_t kp;          // Q4
+    uint16_t ki;          // Q4, per control tick
+    uint16_t kd;          // Q4, per control tick
+    uint16_t kaw;         // Q4, back-calculation anti-windup gain
+    uint16_t out_max;
+    int32_t integrator;   // Q4 output units
+    int32_t d_filtered;   // Q4 output units
+    int16_t meas_prev;
+    bool is_first_call;
+} pid_controller_t;
+
+
+extern void pid_controller_init(pid_controller_t *pid, uint16_t kp, uint16_t ki, uint16_t kd, uint16_t kaw, uint16_t out_max);
+extern void pid_controller_reset(pid_controller_t *pid);
+extern uint16_t pid_controller_process(pid_controller_t *pid, int16_t setpoint, int16_t meas, uint16_t feed_forward);
+
+
+#endif   // _PID_CONTROLLER_H_
@@ -0,0 +1,169 @@
+#include "pwm_driver.h"
+#include <avr/io.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error_handler.h"
+#include "gpio_driver.h"
+
+
+#define WGM1 (14)   // Fast PWM, TOP = ICR1
+
+
+static const uint8_t pwm_ch_pin_portb[PWM_CH_QTY] = {1, 2, 3};   // OC1A, OC1B, OC2
+
+static uint8_t pwm_ch_allocated_msk;
+static bool is_tim1_configured;
+static uint16_t tim1_top;
+static uint8_t tim1_clock_select;
+
+
+
+
+static void pwm_driver_tim1_init(uint16_t top, uint8_t clock_select);
+static void pwm_driver_tim2_init(void);
+
+
+
+
+// Channel allocation, called from drivers init.
+// top / clock_select - timebase wanted by the driver. Tim 1 is configured by the first owner,
+// next owner gets it if the timebase is the same or it can run on the shared one (is_shared_timebase_ok).
+// Conflict - returns false and sets EH_STATUS_FLAG_FW_ERR, the driver must not use the channel.
+bool pwm_driver_alloc(uint8_t ch, uint16_t top, uint8_t clock_select, bool is_shared_timebase_ok) {
+    if (ch >= PWM_CH_QTY) goto pwm_driver_alloc_conflict;
+    if (pwm_ch_allocated_msk & (1 << ch)) goto pwm_driver_alloc_conflict;
+
+    if (ch == PWM_CH_TIM2) {
+        if (!is_shared_timebase_ok && ((top != PWM_TIM2_TOP) || (clock_select != PWM_TIM2_CS))) goto pwm_driver_alloc_conflict;
+        pwm_driver_tim2_init();
+    }
+    else {
+        if (!is_tim1_configured) {
+            pwm_driver_tim1_init(top, clock_select);
+        }
+        else if (!is_shared_timebase_ok && ((top != tim1_top) || (clock_select != tim1_clock_select))) {
+            goto pwm_driver_alloc_conflict;
+        }
+    }
+
+    pwm_ch_allocated_msk |= 1 << ch;
+    pwm_driver_connect(ch, false);
+    pwm_driver_set_ocr(ch, 0);
+    return true;
+
+pwm_driver_alloc_conflict:
+    eh_state |= EH_STATUS_FLAG_FW_ERR;
+    return false;
+}
+
+
+uint16_t pwm_driver_get_top(uint8_t ch) {
+    if (ch == PWM_CH_TIM2) return PWM_TIM2_TOP;
+    return tim1_top;
+}
+
+
+// Output compare pin: connected - non-inverting PWM, disconnected - port value
+void pwm_driver_connect(uint8_t ch, bool is_connected) {
+    switch (ch) {
+        case PWM_CH_TIM1_A:
+            if (is_connected) TCCR1A |= (2 << COM1A0);
+            else TCCR1A &= ~(3 << COM1A0);
+            break;
+
+        case PWM_CH_TIM1_B:
+            if (is_connected) TCCR1A |= (2 << COM1B0);
+            else TCCR1A &= ~(3 << COM1B0);
+            break;
+
+        case PWM_CH_TIM2:
+            #ifdef __AVR_ATmega8__
+            if (is_connected) TCCR2 |= (2 << COM20);
+            else TCCR2 &= ~(3 << COM20);
+            #else
+            if (is_connected) TCCR2A |= (2 << COM2A0);
+            else TCCR2A &= ~(3 << COM2A0);
+            #endif
+            break;
+    }
+}
+
+
+// ocr - timer counts, 0...TOP
+void pwm_driver_set_ocr(uint8_t ch, uint16_t ocr) {
+    switch (ch) {
+        case PWM_CH_TIM1_A:
+            OCR1AH = (uint8_t)(ocr >> 8);
+            OCR1AL = (uint8_t)(ocr >> 0);
+            break;
+
+        case PWM_CH_TIM1_B:
+            OCR1BH = (uint8_t)(ocr >> 8);
+            OCR1BL = (uint8_t)(ocr >> 0);
+            break;
+
+        case PWM_CH_TIM2:
+            if (ocr > PWM_TIM2_TOP) ocr = PWM_TIM2_TOP;
+            #ifdef __AVR_ATmega8__
+            OCR2 = (uint8_t)ocr;
+            #else
+            OCR2A = (uint8_t)ocr;
+            #endif
+            break;
+    }
+}
+
+
+// Compare pin as GPIO (software PWM), the channel must be disconnected
+void pwm_driver_set_pin(uint8_t ch, bool is_high) {
+    if (ch >= PWM_CH_QTY) return;
+    if (is_high) GPIOB_SET(pwm_ch_pin_portb[ch]);
+    else GPIOB_RESET(pwm_ch_pin_portb[ch]);
+}
+
+
+// duty - 0...0xFFFF, scaled to the channel TOP
+void pwm_driver_set_duty(uint8_t ch, uint16_t duty) {
+    pwm_driver_set_ocr(ch, (uint16_t)(((uint32_t)duty * pwm_driver_get_top(ch) + 0x8000) >> 16));
+}
+
+
+
+
+static void pwm_driver_tim1_init(uint16_t top, uint8_t clock_select) {
+    ICR1H = (uint8_t)(top >> 8);
+    ICR1L = (uint8_t)(top >> 0);
+    OCR1AH = 0;
+    OCR1AL = 0;
+    OCR1BH = 0;
+    OCR1BL = 0;
+    TCCR1A = ((WGM1 & 0b11) << WGM10)  |
+             (0 << COM1B0) |    // 0 - OCx disconnected
+             (0 << COM1A0);     // 0 - OCx disconnected, set by owner
+    TCCR1B = (0 << ICNC1) |     // Input Capture Noise Canceler
+             (0 << ICES1) |     // Input Capture Edge Select
+             (((WGM1 & 0b1100) >> 2) << WGM12)  |
+             ((clock_select & 0b111) << CS10);   // Clock Select: 0x00-0x05 -> 0/1/8/64/256/1024
+    // Interrupt Mask Register
+    #ifdef __AVR_ATmega8__
+    TIMSK &= ~((1 << OCIE1B) | (1 << OCIE1A) | (1 << TOIE1));
+    #else
+    TIMSK1 = 0;
+    #endif
+
+    tim1_top = top;
+    tim1_clock_select = clock_select;
+    is_tim1_configured = true;
+}
+
+
+// Fast PWM on top of the systimer counter: TOP = 0xFF, overflow irq rate is not changed
+static void pwm_driver_tim2_init(void) {
+    #ifdef __AVR_ATmega8__
+    OCR2 = 0;
+    TCCR2 |= (1 << WGM21) | (1 << WGM20);
+    #else
+    OCR2A = 0;
+    TCCR2A |= (1 << WGM21) | (1 << WGM20);
+    #endif
+}
@@ -0,0 +1,86 @@
+#ifndef _PWM_DRIVER_H_
+#define _PWM_DRIVER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio_driver.h"
+
+
+// Compare channels
+#define PWM_CH_TIM1_A (0)   // OC1A / PB1, Tim 1 timebase (TOP = ICR1)
+#define PWM_CH_TIM1_B (1)   // OC1B / PB2, Tim 1 timebase (TOP = ICR1)
+#define PWM_CH_TIM2   (2)   // OC2 / PB3, Tim 2 timebase is owned by systimer: F_CPU / 8, TOP = 0xFF
+#define PWM_CH_QTY    (3)
+#define PWM_CH_NONE   (0xFF)   // owner has no PWM output
+
+// Compare output pin (port B) and whether another driver uses it as plain GPIO (gpio_driver.h)
+#define PWM_CH_PORTB_PIN(ch)   (((ch) == PWM_CH_TIM1_A) ? 1 : (((ch) == PWM_CH_TIM1_B) ? 2 : 3))
+#define PWM_CH_IS_GPIO_USED(ch) ((GPIOB_USED_MSK >> PWM_CH_PORTB_PIN(ch)) & 1)
+
+#define PWM_TIM2_TOP  (0xFF)
+#define PWM_TIM2_CS   (2)   // must match the systimer Tim 2 init in main.c
+
+
+// Channel owners, one driver per channel
+#define LED_PWM_CH (PWM_CH_TIM1_A)
+#if PWM_CH_IS_GPIO_USED(LED_PWM_CH)
+#error "pwm_driver: LED PWM pin is used as GPIO"
+#endif
+#if (HEATER_EN != 0)
+#ifndef HEATER_PWM_CH
+#define HEATER_PWM_CH (PWM_CH_TIM2)
+#endif
+#if (HEATER_PWM_CH == LED_PWM_CH)
+#error "pwm_driver: heater and LED use the same PWM channel"
+#endif
+#if (HEATER_PWM_CH >= PWM_CH_QTY)
+#error "pwm_driver: wrong HEATER_PWM_CH"
+#endif
+#if PWM_CH_IS_GPIO_USED(HEATER_PWM_CH)
+#error "pwm_driver: heater PWM pin is used as GPIO"
+#endif
+#if (HEATER_QTY > 1)
+// Second heater takes OC1B/PB2, the fan needs another free channel (FAN_PWM_CH), the current board has none
+#ifndef HEATER_1_PWM_CH
+#define HEATER_1_PWM_CH (PWM_CH_TIM1_B)
+#endif
+#if (HEATER_1_PWM_CH == LED_PWM_CH) || (HEATER_1_PWM_CH == HEATER_PWM_CH)
+#error "pwm_driver: second heater PWM channel is used by another driver"
+#endif
+#if (HEATER_1_PWM_CH >= PWM_CH_QTY)
+#error "pwm_driver: wrong HEATER_1_PWM_CH"
+#endif
+#if PWM_CH_IS_GPIO_USED(HEATER_1_PWM_CH)
+#error "pwm_driver: second heater PWM pin is used as GPIO"
+#endif
+#ifndef FAN_PWM_CH
+#error "pwm_driver: second heater takes the fan PWM channel, set FAN_PWM_CH to a free one"
+#endif
+#if (FAN_PWM_CH == HEATER_1_PWM_CH)
+#error "pwm_driver: fan PWM channel is used by another driver"
+#endif
+#endif
+#ifndef FAN_PWM_CH
+#define FAN_PWM_CH (PWM_CH_TIM1_B)
+#endif
+#if (FAN_PWM_CH == LED_PWM_CH) || (FAN_PWM_CH == HEATER_PWM_CH)
+#error "pwm_driver: fan PWM channel is used by another driver"
+#endif
+#if (FAN_PWM_CH >= PWM_CH_QTY)
+#error "pwm_driver: wrong FAN_PWM_CH, the fan needs a PWM output (cool-down and stall detection)"
+#endif
+#if PWM_CH_IS_GPIO_USED(FAN_PWM_CH)
+#error "pwm_driver: fan PWM pin is used as GPIO"
+#endif
+#endif
+
+
+extern bool pwm_driver_alloc(uint8_t ch, uint16_t top, uint8_t clock_select, bool is_shared_timebase_ok);
+extern uint16_t pwm_driver_get_top(uint8_t ch);
+extern void pwm_driver_connect(uint8_t ch, bool is_connected);
+extern void pwm_driver_set_ocr(uint8_t ch, uint16_t ocr);
+extern void pwm_driver_set_duty(uint8_t ch, uint16_t duty);
+extern void pwm_driver_set_pin(uint8_t ch, bool is_high);
+
+
+#endif   // _PWM_DRIVER_H_
@@ -0,0 +1,93 @@
+#include "sensor_manager.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "twi_driver.h"
+#include "systimer.h"
+
+
+static sensor_manager_sensor_t *sensor_manager_sensors[SENSOR_MANAGER_SENSORS_MAX];
+static uint8_t sensor_manager_sensors_qty;
+
+
+
+
+static void sensor_manager_read_done(twi_driver_msg_t *twi_driver_msg);
+
+
+
+
+void sensor_manager_init(void) {
+    twi_driver_init();
+    sensor_manager_sensors_qty = 0;
+}
+
+
+// Polls every sensor at its own rate in the background, called every main loop
+void sensor_manager_process(void) {
+    uint8_t i;
+    sensor_manager_sensor_t *sensor;
+
+
+    for (i = 0; i < sensor_manager_sensors_qty; i++) {
+        sensor = sensor_manager_sensors[i];
+        if (!systimer_triggered_ms(sensor->poll_timer)) continue;
+        if (twi_driver_is_busy(&sensor->msg)) continue;
+
+        // Keep the conversion grid, restart it if the bus was late by more than a period
+        sensor->poll_timer += sensor->period_ms;
+        if (systimer_triggered_ms(sensor->poll_timer)) sensor->poll_timer = systimer_set_ms(sensor->period_ms);
+        twi_driver_submit(&sensor->msg);
+    }
+
+    twi_driver_process();
+}
+
+
+// first_poll_ms - time to the first conversion result after the sensor setup
+bool sensor_manager_register(sensor_manager_sensor_t *sensor, uint16_t first_poll_ms) {
+    if (sensor_manager_sensors_qty >= SENSOR_MANAGER_SENSORS_MAX) return false;
+
+    sensor->msg.callback = sensor_manager_read_done;
+    sensor->is_valid = false;
+    sensor->err_cnt = 0;
+    sensor->poll_timer = systimer_set_ms(first_poll_ms);
+    sensor_manager_sensors[sensor_manager_sensors_qty] = sensor;
+    sensor_manager_sensors_qty++;
+    return true;
+}
+
+
+// Last cached reading, false - no valid reading or it is older than SENSOR_MANAGER_STALE_PERIODS
+bool sensor_manager_get(sensor_manager_sensor_t *sensor, uint16_t *value) {
+    if (!sensor->is_valid) return false;
+    if (sensor_manager_get_age_ms(sensor) > ((uint32_t)sensor->period_ms * SENSOR_MANAGER_STALE_PERIODS)) return false;
+    *value = sensor->value;
+    return true;
+}
+
+
+uint32_t sensor_manager_get_age_ms(sensor_manager_sensor_t *sensor) {
+    return systimer_get_ms() - sensor->timestamp_ms;
+}
+
+
+
+
+static void sensor_manager_read_done(twi_driver_msg_t *twi_driver_msg) {
+    sensor_manager_sensor_t *sensor = (sensor_manager_sensor_t*)twi_driver_msg;
+    uint16_t value;
+
+
+    if ((twi_driver_msg->result == TWI_DRIVER_RESULT_OK) &&
+        (twi_driver_msg->received_data_qty == twi_driver_msg->rx_data_max_qty) &&
+        sensor->parse(twi_driver_msg->rx_data, &value)) {
+        sensor->value = value;
+        sensor->timestamp_ms = systimer_get_ms();
+        sensor->is_valid = true;
+        sensor->err_cnt = 0;
+        return;
+    }
+
+    if (sensor->err_cnt < SENSOR_MANAGER_ERR_MAX) sensor->err_cnt++;
+    if (sensor->err_cnt >= SENSOR_MANAGER_ERR_MAX) sensor->is_valid = false;
+}
@@ -0,0 +1,38 @@
+#ifndef _SENSOR_MANAGER_H_
+#define _SENSOR_MANAGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "twi_driver.h"
+#include "systimer.h"
+
+
+#define SENSOR_MANAGER_SENSORS_MAX  (4)
+#define SENSOR_MANAGER_ERR_MAX      (3)   // consecutive failed reads before the cache is invalid
+#define SENSOR_MANAGER_STALE_PERIODS (4)
+
+
+typedef bool (*sensor_manager_parse_t)(uint8_t *rx_data, uint16_t *value);
+
+// msg must be the first member: the TWI callback gets the sensor by the message address
+typedef struct {
+    twi_driver_msg_t msg;            // read transaction, prepared by the client
+    uint16_t period_ms;              // sensor conversion time
+    sensor_manager_parse_t parse;    // rx_data -> value, false - reading is not valid
+    // Cache
+    uint16_t value;
+    uint32_t timestamp_ms;
+    bool is_valid;
+    uint8_t err_cnt;
+    timer_t poll_timer;
+} sensor_manager_sensor_t;
+
+
+extern void sensor_manager_init(void);
+extern void sensor_manager_process(void);
+extern bool sensor_manager_register(sensor_manager_sensor_t *sensor, uint16_t first_poll_ms);
+extern bool sensor_manager_get(sensor_manager_sensor_t *sensor, uint16_t *value);
+extern uint32_t sensor_manager_get_age_ms(sensor_manager_sensor_t *sensor);
+
+
+#endif   // _SENSOR_MANAGER_H_
@@ -1,29 +1,68 @@
 #include "systimer.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+
+#if (SYSTIMER_IRQ_CYCLES > SYSTIMER_MS_CYCLES)
+#error "systimer: irq period is over 1 ms"
+#endif
+
 
 static volatile uint32_t systimer_int_counter_ms = 0;
+static volatile uint8_t systimer_int_counter_ovf = 0;
 
 
+// The irq period is not a whole ms (256 us), the remainder is carried in cycles so the ms count does not drift
 void systimer_process_ms(void) {
-    static uint8_t div_cnt = 0;
+    static uint16_t cycles = 0;
     
 
-    div_cnt++;
-    if (div_cnt >= SYSTIMER_PROCESS_CALLS_IN_1MS) {
+    systimer_int_counter_ovf++;
+    cycles += SYSTIMER_IRQ_CYCLES;
+    if (cycles >= SYSTIMER_MS_CYCLES) {
         systimer_int_counter_ms++;
-        div_cnt = 0;
+        cycles -= SYSTIMER_MS_CYCLES;
     }
 }
 
 
 timer_t systimer_set_ms(uint32_t time_ms) {
-    return (systimer_int_counter_ms + time_ms);
+    return (systimer_get_ms() + time_ms);
 }
 
 
 bool systimer_triggered_ms(timer_t timeout) {
-    return (systimer_int_counter_ms >= timeout);
+    return (systimer_get_ms() >= timeout);
+}
+
+
+// 32 bit counter is read with the irq disabled, also called from irqs
+uint32_t systimer_get_ms(void) {
+    uint32_t ms;
+    uint8_t sreg;
+
+
+    sreg = SREG;
+    cli();
+    ms = systimer_int_counter_ms;
+    SREG = sreg;
+    return ms;
+}
+
+
+// Short intervals measurement, SYSTIMER_TICK_CYCLES per tick, wraps in 65 ms
+uint16_t systimer_get_ticks(void) {
+    uint8_t ovf, cnt;
+
+    // Tim 2 overflow irq between the two reads - retry
+    do {
+        ovf = systimer_int_counter_ovf;
+        cnt = TCNT2;
+    } while (ovf != systimer_int_counter_ovf);
+
+    return ((uint16_t)ovf << 8) | cnt;
 }
 
 
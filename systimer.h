@@ -5,7 +5,9 @@
 #include <stdbool.h>
 
 
-#define SYSTIMER_PROCESS_CALLS_IN_1MS (4)
+#define SYSTIMER_TICK_CYCLES          (8)                               // Tim 2 clock: F_CPU / 8
+#define SYSTIMER_IRQ_CYCLES           (256UL * SYSTIMER_TICK_CYCLES)    // Tim 2 overflow, 256 us
+#define SYSTIMER_MS_CYCLES            (F_CPU / 1000)
 
 
 typedef uint32_t timer_t;
@@ -14,6 +16,8 @@ typedef uint32_t timer_t;
 extern void systimer_process_ms(void);
 extern timer_t systimer_set_ms(uint32_t time_ms);
 extern bool systimer_triggered_ms(timer_t timeout);
+extern uint32_t systimer_get_ms(void);
+extern uint16_t systimer_get_ticks(void);
 extern void systimer_delay_ms(uint32_t time_ms);
 
 
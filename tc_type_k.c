@@ -0,0 +1,73 @@
+#include "tc_type_k.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+
+#define TC_TYPE_K_TABLE_SIZE ((TC_TYPE_K_TABLE_MAX_C / TC_TYPE_K_TABLE_STEP_C) + 1)
+
+
+// NIST ITS-90 Type K reference, cold junction at 0 C: EMF in uV every 10 C
+static const uint16_t tc_type_k_uv_table[TC_TYPE_K_TABLE_SIZE] PROGMEM = {
+        0,   397,   798,  1203,  1612,  2023,  2436,  2851,  3267,  3682,   // 0 C
+     4096,  4509,  4920,  5328,  5735,  6138,  6540,  6941,  7340,  7739,   // 100 C
+     8138,  8539,  8940,  9343,  9747, 10153, 10561, 10971, 11382, 11795,   // 200 C
+    12209, 12624, 13040, 13457, 13874, 14293, 14713, 15133, 15554, 15975,   // 300 C
+    16397, 16820, 17243, 17667, 18091, 18516, 18941, 19366, 19792, 20218,   // 400 C
+    20644, 21071, 21497, 21924, 22350, 22776, 23203, 23629, 24055, 24480,   // 500 C
+    24905,   // 600 C
+};
+
+// Segment inverse slope: 10 C * 2^16 / (E[i + 1] - E[i]), saves the division in uV -> C
+static const uint16_t tc_type_k_inv_slope_q16_table[TC_TYPE_K_TABLE_SIZE - 1] PROGMEM = {
+     1651,  1634,  1618,  1602,  1595,  1587,  1579,  1575,  1579,  1583,   // 0 C
+     1587,  1595,  1606,  1610,  1626,  1630,  1634,  1643,  1643,  1643,   // 100 C
+     1634,  1634,  1626,  1622,  1614,  1606,  1598,  1595,  1587,  1583,   // 200 C
+     1579,  1575,  1572,  1572,  1564,  1560,  1560,  1557,  1557,  1553,   // 300 C
+     1549,  1549,  1546,  1546,  1542,  1542,  1542,  1538,  1538,  1538,   // 400 C
+     1535,  1538,  1535,  1538,  1538,  1535,  1538,  1538,  1542,  1542,   // 500 C
+};
+
+
+
+
+// Binary search (6 steps) + one 16x16->32 multiply
+uint16_t tc_type_k_uv_to_c(uint16_t emf_uv) {
+    uint8_t low, high, mid;
+    uint16_t segment_uv;
+    uint32_t segment_c_q16;
+
+
+    if (emf_uv >= pgm_read_word(&tc_type_k_uv_table[TC_TYPE_K_TABLE_SIZE - 1])) return TC_TYPE_K_TABLE_MAX_C;
+
+    // Find segment: table[low] <= emf_uv < table[low + 1]
+    low = 0;
+    high = TC_TYPE_K_TABLE_SIZE - 1;
+    while ((high - low) > 1) {
+        mid = (low + high) >> 1;
+        if (pgm_read_word(&tc_type_k_uv_table[mid]) <= emf_uv) low = mid;
+        else high = mid;
+    }
+
+    segment_uv = emf_uv - pgm_read_word(&tc_type_k_uv_table[low]);
+    segment_c_q16 = (uint32_t)segment_uv * pgm_read_word(&tc_type_k_inv_slope_q16_table[low]);
+
+    return ((uint16_t)low * TC_TYPE_K_TABLE_STEP_C) + (uint16_t)((segment_c_q16 + 0x8000) >> 16);
+}
+
+
+// temperature_c16 - 1/16 C (MCP9804 format), used for cold junction compensation
+uint16_t tc_type_k_c16_to_uv(uint16_t temperature_c16) {
+    uint8_t i;
+    uint16_t segment_c16;
+    uint16_t e_low, e_high;
+
+
+    if (temperature_c16 >= (TC_TYPE_K_TABLE_MAX_C << 4)) return pgm_read_word(&tc_type_k_uv_table[TC_TYPE_K_TABLE_SIZE - 1]);
+
+    i = temperature_c16 / (TC_TYPE_K_TABLE_STEP_C << 4);
+    segment_c16 = temperature_c16 - ((uint16_t)i * (TC_TYPE_K_TABLE_STEP_C << 4));
+    e_low = pgm_read_word(&tc_type_k_uv_table[i]);
+    e_high = pgm_read_word(&tc_type_k_uv_table[i + 1]);
+
+    return e_low + (uint16_t)(((uint32_t)(e_high - e_low) * segment_c16) / (TC_TYPE_K_TABLE_STEP_C << 4));
+}
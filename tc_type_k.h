@@ -0,0 +1,15 @@
+#ifndef _TC_TYPE_K_H_
+#define _TC_TYPE_K_H_
+
+#include <stdint.h>
+
+
+#define TC_TYPE_K_TABLE_STEP_C (10)
+#define TC_TYPE_K_TABLE_MAX_C  (600)
+
+
+extern uint16_t tc_type_k_uv_to_c(uint16_t emf_uv);
+extern uint16_t tc_type_k_c16_to_uv(uint16_t temperature_c16);
+
+
+#endif   // _TC_TYPE_K_H_
@@ -2,152 +2,256 @@
 #include <stdbool.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/delay.h>
 #include "twi_driver.h"
 #include "systimer.h"
+#include "gpio_driver.h"
 
 
+// SCLfreq = COREfreq / (16 + 2 * TWBR * presc), presc = 1
+#define TWI_DRIVER_TWBR_CALC   (((F_CPU / TWI_DRIVER_SCL_HZ) - 16) / 2)
+#if (TWI_DRIVER_TWBR_CALC < 10)
+#define TWI_DRIVER_TWBR        (10)   // master mode minimum, 8 MHz -> 222 kHz
+#elif (TWI_DRIVER_TWBR_CALC > 0xFF)
+#error "twi_driver: TWI_DRIVER_SCL_HZ out of range"
+#else
+#define TWI_DRIVER_TWBR        (TWI_DRIVER_TWBR_CALC)
+#endif
+
+#define TWI_DRIVER_TWCR_NEXT   ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+
+// Bus recovery, pins are driven as open drain
+#define TWI_DRIVER_SDA_PIN     (4)
+#define TWI_DRIVER_SCL_PIN     (5)
+#define TWI_DRIVER_SDA_STATE   (GPIOC_GET(TWI_DRIVER_SDA_PIN))
+#define TWI_DRIVER_RECOVERY_CLOCKS  (9)
+#define TWI_DRIVER_RECOVERY_HALF_US (5)
 
 
 typedef enum {
     TWI_DRIVER_STATUS_START_TX_OK = 0x08,
     TWI_DRIVER_STATUS_RPT_START_TX_OK = 0x10,
     TWI_DRIVER_STATUS_SLA_W_TX_ACK = 0x18,
+    TWI_DRIVER_STATUS_SLA_W_TX_NACK = 0x20,
     TWI_DRIVER_STATUS_DATA_TX_ACK = 0x28,
+    TWI_DRIVER_STATUS_DATA_TX_NACK = 0x30,
     TWI_DRIVER_STATUS_SLA_R_TX_ACK = 0x40,
+    TWI_DRIVER_STATUS_SLA_R_TX_NACK = 0x48,
     TWI_DRIVER_STATUS_DATA_RX_ACK = 0x50,
+    TWI_DRIVER_STATUS_DATA_RX_NACK = 0x58,
 } twi_driver_status_t;
 
 
+static twi_driver_msg_t *twi_driver_queue[TWI_DRIVER_QUEUE_SIZE];
+static uint8_t twi_driver_queue_head;
+static uint8_t twi_driver_queue_qty;
+static twi_driver_msg_t *volatile twi_driver_active_msg;   // owned by the irq until is_twi_driver_done
+static volatile bool is_twi_driver_done;
+static volatile uint8_t twi_driver_active_result;
+static uint8_t twi_driver_data_idx;
+static volatile bool is_twi_driver_rx;
+static timer_t twi_driver_timer;
+
+
+
+
+static void twi_driver_start_next(void);
+static void twi_driver_finish(twi_driver_result_t result);
+static void twi_driver_rx_next(void);
+static void twi_driver_bus_recovery(void);
 
 
 
 
-// slave_addr = aaaaaaa0
 void twi_driver_init(void) {
-    // SCLfreq = COREfreq / (16 + 2 * TWBR * presc)
-    // TWBR = ((COREfreq / SCLfreq) - 16) / (2 * presc)
-    // TWBR = ((8000000 / 100000) - 16) / (2 * 1) = 32
-    TWBR = 32;
+    TWBR = TWI_DRIVER_TWBR;
     TWSR = (0 << TWPS0);  // Prescaler Value 1/4/16/64
     TWCR = (1 << TWEN);
+
+    twi_driver_queue_head = 0;
+    twi_driver_queue_qty = 0;
+    twi_driver_active_msg = 0;
+}
+
+
+// Delivers the finished transaction to its callback and starts the next one, called every main loop
+void twi_driver_process(void) {
+    twi_driver_msg_t *msg;
+
+
+    msg = twi_driver_active_msg;
+    if (msg == 0) {
+        twi_driver_start_next();
+        return;
+    }
+
+    if (!is_twi_driver_done) {
+        if (!systimer_triggered_ms(twi_driver_timer)) return;
+        TWCR = 0;   // TWI and its irq off
+        if (!is_twi_driver_done) twi_driver_active_result = TWI_DRIVER_RESULT_TIMEOUT;
+    }
+    msg->result = twi_driver_active_result;
+    if ((msg->result == TWI_DRIVER_RESULT_TIMEOUT) || (msg->result == TWI_DRIVER_RESULT_BUS_ERR)) twi_driver_bus_recovery();
+
+    twi_driver_queue_head = (twi_driver_queue_head + 1) % TWI_DRIVER_QUEUE_SIZE;
+    twi_driver_queue_qty--;
+    twi_driver_active_msg = 0;
+
+    if (msg->callback != 0) msg->callback(msg);
+    twi_driver_start_next();
+}
+
+
+// Queues the message, it must stay valid until the result is not TWI_DRIVER_RESULT_BUSY
+bool twi_driver_submit(twi_driver_msg_t *twi_driver_msg) {
+    if ((twi_driver_queue_qty >= TWI_DRIVER_QUEUE_SIZE) || (twi_driver_msg->result == TWI_DRIVER_RESULT_BUSY)) return false;
+
+    twi_driver_msg->result = TWI_DRIVER_RESULT_BUSY;
+    twi_driver_queue[(twi_driver_queue_head + twi_driver_queue_qty) % TWI_DRIVER_QUEUE_SIZE] = twi_driver_msg;
+    twi_driver_queue_qty++;
+    twi_driver_start_next();
+    return true;
+}
+
+
+bool twi_driver_is_busy(twi_driver_msg_t *twi_driver_msg) {
+    return (twi_driver_msg->result == TWI_DRIVER_RESULT_BUSY);
 }
 
 
+// Blocking, for the init code only (irq and systimer must run)
 twi_driver_result_t twi_driver_transmit(twi_driver_msg_t *twi_driver_msg) {
-    twi_driver_result_t twi_driver_result = TWI_DRIVER_RESULT_OK;
-    uint8_t i;
-    timer_t transaction_timer;
+    if (!twi_driver_submit(twi_driver_msg)) return TWI_DRIVER_RESULT_BUSY;
+    while (twi_driver_is_busy(twi_driver_msg)) twi_driver_process();
+    return (twi_driver_result_t)twi_driver_msg->result;
+}
+
+
 
 
-    transaction_timer = systimer_set_ms(twi_driver_msg->timeout_ms);
+static void twi_driver_start_next(void) {
+    twi_driver_msg_t *msg;
+
+
+    if ((twi_driver_active_msg != 0) || (twi_driver_queue_qty == 0)) return;
+    if (TWCR & (1 << TWSTO)) return;   // STOP of the previous transaction is not sent yet
+
+    msg = twi_driver_queue[twi_driver_queue_head];
+    msg->received_data_qty = 0;
+    is_twi_driver_rx = (msg->tx_data_qty == 0) && (msg->rx_data_max_qty != 0);
+    is_twi_driver_done = false;
+    twi_driver_active_msg = msg;
+    twi_driver_timer = systimer_set_ms(msg->timeout_ms);
 
     // Send START condition
-    TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
-    // Wait for TWINT Flag set. This indicates that the START condition has been transmitted
-    while (!(TWCR & (1 << TWINT))) {
-        if (systimer_triggered_ms(transaction_timer)) {
-            twi_driver_result = (twi_driver_result_t)(0x80 | 1);
-            *twi_driver_msg->received_data_qty = TWSR;
-            goto twi_driver_err;
-        }
-    }
-    // Check value of TWI Status Register. Mask prescaler bits. If status different from START go to ERROR
-    if ((TWSR & 0xF8) != TWI_DRIVER_STATUS_START_TX_OK) {
-        twi_driver_result = TWI_DRIVER_RESULT_START_ERR;
-        *twi_driver_msg->received_data_qty = TWSR;
-        goto twi_driver_err;
+    TWCR = TWI_DRIVER_TWCR_NEXT | (1 << TWSTA);
+}
+
+
+// irq context
+static void twi_driver_finish(twi_driver_result_t result) {
+    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);   // Transmit STOP condition, irq off
+    twi_driver_active_result = result;
+    is_twi_driver_done = true;
+}
+
+
+// irq context, ACK all bytes except the last one
+static void twi_driver_rx_next(void) {
+    if ((twi_driver_data_idx + 1) < twi_driver_active_msg->rx_data_max_qty) TWCR = TWI_DRIVER_TWCR_NEXT | (1 << TWEA);
+    else TWCR = TWI_DRIVER_TWCR_NEXT;
+}
+
+
+// Slave holds SDA low (reset in the middle of a byte): clock it out, then STOP
+static void twi_driver_bus_recovery(void) {
+    uint8_t i;
+
+
+    TWCR = 0;
+    GPIOC_RESET(TWI_DRIVER_SCL_PIN);
+    GPIOC_RESET(TWI_DRIVER_SDA_PIN);
+    GPIOC_MODE_INPUT(TWI_DRIVER_SDA_PIN);
+
+    for (i = 0; (i < TWI_DRIVER_RECOVERY_CLOCKS) && ((TWI_DRIVER_SDA_STATE) == 0); i++) {
+        GPIOC_MODE_OUTPUT(TWI_DRIVER_SCL_PIN);
+        _delay_us(TWI_DRIVER_RECOVERY_HALF_US);
+        GPIOC_MODE_INPUT(TWI_DRIVER_SCL_PIN);
+        _delay_us(TWI_DRIVER_RECOVERY_HALF_US);
     }
 
-    // Send data
-    if (twi_driver_msg->tx_data_qty != 0) {
-        // Send slave addr + W
-        TWDR = twi_driver_msg->slave_addr | 0;
-        TWCR = (1 << TWINT) | (1 << TWEN);
-        while (!(TWCR & (1 << TWINT))) {
-            if (systimer_triggered_ms(transaction_timer)) {
-                twi_driver_result = (twi_driver_result_t)(0x80 | 2);
-                *twi_driver_msg->received_data_qty = TWSR;
-                goto twi_driver_err;
+    // STOP: SDA low -> high while SCL is high
+    GPIOC_MODE_OUTPUT(TWI_DRIVER_SDA_PIN);
+    _delay_us(TWI_DRIVER_RECOVERY_HALF_US);
+    GPIOC_MODE_INPUT(TWI_DRIVER_SDA_PIN);
+    _delay_us(TWI_DRIVER_RECOVERY_HALF_US);
+
+    TWCR = (1 << TWEN);
+}
+
+
+
+
+ISR(TWI_vect) {
+    twi_driver_msg_t *msg = twi_driver_active_msg;
+
+
+    switch (TWSR & 0xF8) {
+        case TWI_DRIVER_STATUS_START_TX_OK:
+        case TWI_DRIVER_STATUS_RPT_START_TX_OK:
+            twi_driver_data_idx = 0;
+            if (is_twi_driver_rx) TWDR = msg->slave_addr | 1;
+            else TWDR = msg->slave_addr | 0;
+            TWCR = TWI_DRIVER_TWCR_NEXT;
+            break;
+
+        case TWI_DRIVER_STATUS_SLA_W_TX_ACK:
+        case TWI_DRIVER_STATUS_DATA_TX_ACK:
+            if (twi_driver_data_idx < msg->tx_data_qty) {
+                TWDR = msg->tx_data[twi_driver_data_idx++];
+                TWCR = TWI_DRIVER_TWCR_NEXT;
             }
-        }
-        if ((TWSR & 0xF8) != TWI_DRIVER_STATUS_SLA_W_TX_ACK)  {
-            twi_driver_result = TWI_DRIVER_RESULT_SLA_W_ERR;
-            *twi_driver_msg->received_data_qty = TWSR;
-            goto twi_driver_err;
-        }
-
-        for (i = 0; i < twi_driver_msg->tx_data_qty; i++) {
-            TWDR = twi_driver_msg->tx_data[i];
-            TWCR = (1 << TWINT) | (1 << TWEN);
-            while (!(TWCR & (1 << TWINT))) {
-                if (systimer_triggered_ms(transaction_timer)) {
-                    twi_driver_result = (twi_driver_result_t)(0x80 | 3);
-                    *twi_driver_msg->received_data_qty = TWSR;
-                    goto twi_driver_err;
-                }
+            else if (msg->rx_data_max_qty != 0) {
+                // Send repeat START condition
+                is_twi_driver_rx = true;
+                TWCR = TWI_DRIVER_TWCR_NEXT | (1 << TWSTA);
             }
-            if ((TWSR & 0xF8) != TWI_DRIVER_STATUS_DATA_TX_ACK)  {
-                twi_driver_result = TWI_DRIVER_RESULT_DATA_TX_ERR;
-                *twi_driver_msg->received_data_qty = TWSR;
-                goto twi_driver_err;
+            else {
+                twi_driver_finish(TWI_DRIVER_RESULT_OK);
             }
-        }
-    }
+            break;
 
-    if ((twi_driver_msg->tx_data_qty != 0) && (twi_driver_msg->rx_data_max_qty != 0)) {
-        // Send repeat START condition
-        TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
-        while (!(TWCR & (1 << TWINT))) {
-            if (systimer_triggered_ms(transaction_timer)) {
-                twi_driver_result = (twi_driver_result_t)(0x80 | 4);
-                *twi_driver_msg->received_data_qty = TWSR;
-                goto twi_driver_err;
-            }
-        }
-        if ((TWSR & 0xF8) != TWI_DRIVER_STATUS_RPT_START_TX_OK) {
-            twi_driver_result = TWI_DRIVER_RESULT_START_ERR;
-            *twi_driver_msg->received_data_qty = TWSR;   ////
-            goto twi_driver_err;
-        }
-    }
+        case TWI_DRIVER_STATUS_SLA_R_TX_ACK:
+            twi_driver_rx_next();
+            break;
 
-    // Receive data
-    if (twi_driver_msg->rx_data_max_qty != 0) {
-        // Send slave addr + R
-        TWDR = twi_driver_msg->slave_addr | 1;
-        TWCR = (1 << TWINT) | (1 << TWEN);
-        while (!(TWCR & (1 << TWINT))) {
-            if (systimer_triggered_ms(transaction_timer)) {
-                twi_driver_result = (twi_driver_result_t)(0x80 | 5);
-                *twi_driver_msg->received_data_qty = TWSR;
-                goto twi_driver_err;
-            }
-        }
-        if ((TWSR & 0xF8) != TWI_DRIVER_STATUS_SLA_R_TX_ACK)  {
-            twi_driver_result = TWI_DRIVER_RESULT_SLA_R_ERR;
-            *twi_driver_msg->received_data_qty = TWSR;
-            goto twi_driver_err;
-        }
-
-        for (i = 0; i < twi_driver_msg->rx_data_max_qty; i++) {
-            if (i == (twi_driver_msg->rx_data_max_qty - 1)) TWCR = (1 << TWINT) | (1 << TWEN);
-            else TWCR = (1 << TWEA) | (1 << TWINT) | (1 << TWEN);
-            while (!(TWCR & (1 << TWINT))) {
-                if (systimer_triggered_ms(transaction_timer)) {
-                    twi_driver_result = (twi_driver_result_t)(0x80 | 6);
-                    *twi_driver_msg->received_data_qty = TWSR;
-                    goto twi_driver_err;
-                }
-            }
-            twi_driver_msg->rx_data[i] = TWDR;
-            if ((TWSR & 0xF8) != TWI_DRIVER_STATUS_DATA_RX_ACK) break;
-        }
+        case TWI_DRIVER_STATUS_DATA_RX_ACK:
+            msg->rx_data[twi_driver_data_idx++] = TWDR;
+            msg->received_data_qty = twi_driver_data_idx;
+            twi_driver_rx_next();
+            break;
 
-        *twi_driver_msg->received_data_qty = i;
-    }
+        case TWI_DRIVER_STATUS_DATA_RX_NACK:
+            msg->rx_data[twi_driver_data_idx++] = TWDR;
+            msg->received_data_qty = twi_driver_data_idx;
+            twi_driver_finish(TWI_DRIVER_RESULT_OK);
+            break;
+
+        case TWI_DRIVER_STATUS_SLA_W_TX_NACK:
+            twi_driver_finish(TWI_DRIVER_RESULT_SLA_W_ERR);
+            break;
 
+        case TWI_DRIVER_STATUS_DATA_TX_NACK:
+            twi_driver_finish(TWI_DRIVER_RESULT_DATA_TX_ERR);
+            break;
 
-twi_driver_err:
-    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);   // Transmit STOP condition
-    return twi_driver_result;
+        case TWI_DRIVER_STATUS_SLA_R_TX_NACK:
+            twi_driver_finish(TWI_DRIVER_RESULT_SLA_R_ERR);
+            break;
+
+        default:
+            // Bus error, arbitration lost
+            twi_driver_finish(TWI_DRIVER_RESULT_BUS_ERR);
+            break;
+    }
 }
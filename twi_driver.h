@@ -1,19 +1,16 @@
 #include <stdint.h>
+#include <stdbool.h>
 
 
 #ifndef TWI_DRIVER_H
 #define TWI_DRIVER_H
 
 
-typedef struct {
-    uint8_t slave_addr;   // slave_addr = aaaaaaa0
-    uint32_t timeout_ms;
-    uint8_t tx_data_qty;
-    uint8_t *tx_data;
-    uint8_t rx_data_max_qty;
-    uint8_t *rx_data;
-    uint8_t *received_data_qty;
-} twi_driver_msg_t;
+#ifndef TWI_DRIVER_SCL_HZ
+#define TWI_DRIVER_SCL_HZ     (400000UL)   // fast mode, limited by TWBR >= 10 (ATmega8 master mode)
+#endif
+#define TWI_DRIVER_QUEUE_SIZE (4)
+
 
 typedef enum {
     TWI_DRIVER_RESULT_OK            = 0,
@@ -22,10 +19,30 @@ typedef enum {
     TWI_DRIVER_RESULT_DATA_TX_ERR   = 3,
     TWI_DRIVER_RESULT_SLA_R_ERR     = 4,
     TWI_DRIVER_RESULT_TIMEOUT       = 5,
+    TWI_DRIVER_RESULT_BUS_ERR       = 6,   // bus error or arbitration lost, bus is recovered
+    TWI_DRIVER_RESULT_BUSY          = 7,   // queued or in progress
 } twi_driver_result_t;
 
+typedef struct twi_driver_msg_s twi_driver_msg_t;
+typedef void (*twi_driver_callback_t)(twi_driver_msg_t *twi_driver_msg);
+
+struct twi_driver_msg_s {
+    uint8_t slave_addr;   // slave_addr = aaaaaaa0
+    uint32_t timeout_ms;
+    uint8_t tx_data_qty;
+    uint8_t *tx_data;
+    uint8_t rx_data_max_qty;
+    uint8_t *rx_data;
+    uint8_t received_data_qty;
+    twi_driver_callback_t callback;   // called from twi_driver_process(), may be 0
+    uint8_t result;                   // twi_driver_result_t, BUSY until the callback
+};
+
 
 extern void twi_driver_init(void);
+extern void twi_driver_process(void);
+extern bool twi_driver_submit(twi_driver_msg_t *twi_driver_msg);
+extern bool twi_driver_is_busy(twi_driver_msg_t *twi_driver_msg);
 extern twi_driver_result_t twi_driver_transmit(twi_driver_msg_t *twi_driver_msg);
 
 